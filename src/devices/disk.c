@@ -28,6 +28,10 @@
 #define reg_ctl(CHANNEL) ((CHANNEL)->reg_base + 0x206)  /* Control (w/o). */
 #define reg_alt_status(CHANNEL) reg_ctl (CHANNEL)       /* Alt Status (r/o). */
 
+/* Ticks to wait for a read or write to complete before giving
+   up on the channel as stuck. */
+#define DISK_TIMEOUT (30 * TIMER_FREQ)
+
 /* Alternate Status Register bits. */
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
@@ -60,6 +64,9 @@ struct disk
 
     long long read_cnt;         /* Number of sectors read. */
     long long write_cnt;        /* Number of sectors written. */
+    int64_t read_ns;            /* Total time spent reading. */
+    int64_t write_ns;           /* Total time spent writing. */
+    int64_t max_ns;             /* Longest single read or write. */
   };
 
 /* An ATA channel (aka controller).
@@ -90,6 +97,7 @@ static void select_sector (struct disk *, disk_sector_t);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
+static void account_io (struct disk *, int64_t *total_ns, int64_t start);
 
 static void wait_until_idle (const struct disk *);
 static bool wait_while_busy (const struct disk *);
@@ -124,7 +132,7 @@ disk_init (void)
         default:
           NOT_REACHED ();
         }
-      lock_init (&c->lock);
+      lock_init_named (&c->lock, "disk channel");
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
  
@@ -140,6 +148,7 @@ disk_init (void)
           d->capacity = 0;
 
           d->read_cnt = d->write_cnt = 0;
+          d->read_ns = d->write_ns = d->max_ns = 0;
         }
 
       /* Register interrupt handler. */
@@ -173,8 +182,10 @@ disk_print_stats (void)
         {
           struct disk *d = disk_get (chan_no, dev_no);
           if (d != NULL && d->is_ata) 
-            printf ("%s: %lld reads, %lld writes\n",
-                    d->name, d->read_cnt, d->write_cnt);
+            printf ("%s: %lld reads (%lld us), %lld writes (%lld us), "
+                    "longest %lld us\n",
+                    d->name, d->read_cnt, d->read_ns / 1000,
+                    d->write_cnt, d->write_ns / 1000, d->max_ns / 1000);
         }
     }
 }
@@ -220,19 +231,23 @@ void
 disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) 
 {
   struct channel *c;
+  int64_t start;
   
   ASSERT (d != NULL);
   ASSERT (buffer != NULL);
 
   c = d->channel;
   lock_acquire (&c->lock);
+  start = timer_ns ();
   select_sector (d, sec_no);
   issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
+  if (!sema_down_timeout (&c->completion_wait, DISK_TIMEOUT))
+    PANIC ("%s: disk read timed out, sector=%"PRDSNu, d->name, sec_no);
   if (!wait_while_busy (d))
     PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
   input_sector (c, buffer);
   d->read_cnt++;
+  account_io (d, &d->read_ns, start);
   lock_release (&c->lock);
 }
 
@@ -245,21 +260,37 @@ void
 disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer)
 {
   struct channel *c;
+  int64_t start;
   
   ASSERT (d != NULL);
   ASSERT (buffer != NULL);
 
   c = d->channel;
   lock_acquire (&c->lock);
+  start = timer_ns ();
   select_sector (d, sec_no);
   issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
   if (!wait_while_busy (d))
     PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
   output_sector (c, buffer);
-  sema_down (&c->completion_wait);
+  if (!sema_down_timeout (&c->completion_wait, DISK_TIMEOUT))
+    PANIC ("%s: disk write timed out, sector=%"PRDSNu, d->name, sec_no);
   d->write_cnt++;
+  account_io (d, &d->write_ns, start);
   lock_release (&c->lock);
 }
+
+/* Adds the time since START, a value of timer_ns(), to *TOTAL_NS
+   and to D's longest operation time if it is a new maximum. */
+static void
+account_io (struct disk *d, int64_t *total_ns, int64_t start) 
+{
+  int64_t elapsed = timer_ns () - start;
+
+  *total_ns += elapsed;
+  if (elapsed > d->max_ns)
+    d->max_ns = elapsed;
+}
 
 /* Disk detection and identification. */
 
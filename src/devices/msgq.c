@@ -0,0 +1,229 @@
+#include "devices/msgq.h"
+#include <debug.h>
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+
+static size_t put_some (struct msgq *, void *const msgs[], size_t cnt);
+static size_t get_some (struct msgq *, void *msgs[], size_t cnt);
+static void wait (struct list *waiters);
+static void wake (struct list *waiters, size_t cnt);
+
+/* Initializes message queue Q to hold up to CAPACITY messages in
+   BUF, which must have room for that many pointers and must
+   outlive Q. */
+void
+msgq_init (struct msgq *q, void **buf, size_t capacity) 
+{
+  ASSERT (q != NULL);
+  ASSERT (buf != NULL);
+  ASSERT (capacity > 0);
+
+  q->buf = buf;
+  q->capacity = capacity;
+  q->head = q->count = 0;
+  list_init (&q->not_full);
+  list_init (&q->not_empty);
+}
+
+/* Returns the number of messages in Q.  The value may be stale
+   by the time the caller examines it, unless interrupts are
+   off. */
+size_t
+msgq_count (const struct msgq *q) 
+{
+  return q->count;
+}
+
+/* Returns true if Q is empty, false otherwise. */
+bool
+msgq_empty (const struct msgq *q) 
+{
+  return q->count == 0;
+}
+
+/* Returns true if Q is full, false otherwise. */
+bool
+msgq_full (const struct msgq *q) 
+{
+  return q->count == q->capacity;
+}
+
+/* Adds MSG to the end of Q, first sleeping until there is room
+   if Q is full. */
+void
+msgq_put (struct msgq *q, void *msg) 
+{
+  msgq_put_many (q, &msg, 1);
+}
+
+/* Removes the oldest message from Q and returns it, first
+   sleeping until a message is added if Q is empty. */
+void *
+msgq_get (struct msgq *q) 
+{
+  void *msg;
+
+  msgq_get_many (q, &msg, 1);
+  return msg;
+}
+
+/* Adds MSG to the end of Q and returns true, or returns false
+   without waiting if Q is full. */
+bool
+msgq_try_put (struct msgq *q, void *msg) 
+{
+  return msgq_try_put_many (q, &msg, 1) == 1;
+}
+
+/* Removes the oldest message from Q, stores it in *MSG and
+   returns true, or returns false without waiting if Q is
+   empty. */
+bool
+msgq_try_get (struct msgq *q, void **msg) 
+{
+  return msgq_try_get_many (q, msg, 1) == 1;
+}
+
+/* Adds the CNT messages in MSGS to the end of Q, in order,
+   sleeping whenever Q is full until all of them have been
+   added.  Another producer's messages may be interleaved with
+   them if CNT exceeds the room in Q. */
+void
+msgq_put_many (struct msgq *q, void *const msgs[], size_t cnt) 
+{
+  enum intr_level old_level;
+
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  for (;;) 
+    {
+      size_t n = put_some (q, msgs, cnt);
+      msgs += n;
+      cnt -= n;
+      if (cnt == 0)
+        break;
+      wait (&q->not_full);
+    }
+  intr_set_level (old_level);
+}
+
+/* Removes up to CNT of the oldest messages from Q into MSGS,
+   first sleeping until a message is added if Q is empty.
+   Returns the number of messages removed, which is at least 1
+   if CNT is positive. */
+size_t
+msgq_get_many (struct msgq *q, void *msgs[], size_t cnt) 
+{
+  enum intr_level old_level;
+  size_t n;
+
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  while ((n = get_some (q, msgs, cnt)) == 0 && cnt > 0)
+    wait (&q->not_empty);
+  intr_set_level (old_level);
+
+  return n;
+}
+
+/* Adds as many of the CNT messages in MSGS to the end of Q, in
+   order, as there is room for, without waiting.  Returns the
+   number added. */
+size_t
+msgq_try_put_many (struct msgq *q, void *const msgs[], size_t cnt) 
+{
+  enum intr_level old_level;
+  size_t n;
+
+  old_level = intr_disable ();
+  n = put_some (q, msgs, cnt);
+  intr_set_level (old_level);
+
+  return n;
+}
+
+/* Removes up to CNT of the oldest messages from Q into MSGS,
+   without waiting.  Returns the number removed. */
+size_t
+msgq_try_get_many (struct msgq *q, void *msgs[], size_t cnt) 
+{
+  enum intr_level old_level;
+  size_t n;
+
+  old_level = intr_disable ();
+  n = get_some (q, msgs, cnt);
+  intr_set_level (old_level);
+
+  return n;
+}
+
+/* Copies as many of the CNT messages in MSGS into Q as fit, and
+   wakes up one waiting consumer per message added.  Returns the
+   number of messages added.  Interrupts must be off. */
+static size_t
+put_some (struct msgq *q, void *const msgs[], size_t cnt) 
+{
+  size_t n, i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  n = q->capacity - q->count;
+  if (n > cnt)
+    n = cnt;
+  for (i = 0; i < n; i++)
+    q->buf[(q->head + q->count + i) % q->capacity] = msgs[i];
+  q->count += n;
+
+  wake (&q->not_empty, n);
+  return n;
+}
+
+/* Moves up to CNT of the oldest messages from Q into MSGS, and
+   wakes up one waiting producer per message removed.  Returns
+   the number of messages removed.  Interrupts must be off. */
+static size_t
+get_some (struct msgq *q, void *msgs[], size_t cnt) 
+{
+  size_t n, i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  n = q->count < cnt ? q->count : cnt;
+  for (i = 0; i < n; i++)
+    msgs[i] = q->buf[(q->head + i) % q->capacity];
+  q->head = (q->head + n) % q->capacity;
+  q->count -= n;
+
+  wake (&q->not_full, n);
+  return n;
+}
+
+/* Sleeps on WAITERS until woken up by wake().  Interrupts must
+   be off. */
+static void
+wait (struct list *waiters) 
+{
+  ASSERT (!intr_context ());
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_push_back (waiters, &thread_current ()->elem);
+  thread_block ();
+}
+
+/* Wakes up to CNT of the threads on WAITERS, oldest first, then
+   yields once if any of them outranks the running thread.
+   Interrupts must be off. */
+static void
+wake (struct list *waiters, size_t cnt) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (cnt == 0 || list_empty (waiters))
+    return;
+  while (cnt-- > 0 && !list_empty (waiters))
+    thread_unblock (list_entry (list_pop_front (waiters),
+                                struct thread, elem));
+  thread_preempt ();
+}
@@ -0,0 +1,46 @@
+#ifndef DEVICES_MSGQ_H
+#define DEVICES_MSGQ_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* A "message queue", a bounded circular buffer of pointer-sized
+   messages shared among any number of producer and consumer
+   threads.
+
+   The buffer is supplied by the caller, so that passing a message
+   never allocates memory.  Threads that find the queue full (to
+   put) or empty (to get) wait in FIFO order, any number on each
+   side.  The msgq_try_*() functions never sleep, so they may
+   also be called from interrupt handlers.
+
+   Like the interrupt queue in devices/intq.h, the message queue
+   protects itself by turning interrupts off, so that interrupt
+   handlers can use it. */
+struct msgq
+  {
+    void **buf;                 /* Buffer. */
+    size_t capacity;            /* Number of elements in BUF. */
+    size_t head;                /* Index of oldest message. */
+    size_t count;               /* Number of messages in BUF. */
+    struct list not_full;       /* Threads waiting to put. */
+    struct list not_empty;      /* Threads waiting to get. */
+  };
+
+void msgq_init (struct msgq *, void **buf, size_t capacity);
+size_t msgq_count (const struct msgq *);
+bool msgq_empty (const struct msgq *);
+bool msgq_full (const struct msgq *);
+
+void msgq_put (struct msgq *, void *msg);
+void *msgq_get (struct msgq *);
+bool msgq_try_put (struct msgq *, void *msg);
+bool msgq_try_get (struct msgq *, void **msg);
+
+void msgq_put_many (struct msgq *, void *const msgs[], size_t cnt);
+size_t msgq_get_many (struct msgq *, void *msgs[], size_t cnt);
+size_t msgq_try_put_many (struct msgq *, void *const msgs[], size_t cnt);
+size_t msgq_try_get_many (struct msgq *, void *msgs[], size_t cnt);
+
+#endif /* devices/msgq.h */
@@ -18,20 +18,92 @@
 #error TIMER_FREQ <= 1000 recommended
 #endif
 
-/* List of sleeping threads */
-static struct list sleep_list;
+/* 8254 input frequency divided by TIMER_FREQ, rounded to
+   nearest: the PIT count for one timer tick. */
+#define PIT_TICK_COUNT ((1193180 + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* timer_enter_idle() stays periodic if the PIT is fewer than this
+   many cycles from the next tick, because the tick might arrive
+   while the PIT is being reprogrammed. */
+#define PIT_IDLE_MARGIN 64
+
+/* Pending callouts, including those that wake up sleeping
+   threads, are kept in a hierarchical timer wheel, so that both
+   adding a callout and expiring one take constant time.
+
+   Level 0 has one slot per tick for the next WHEEL_SIZE ticks.
+   Each slot at level L covers WHEEL_SIZE**L ticks, and whenever
+   the level-0 index wraps around to 0, the next slot of level 1
+   is "cascaded": its callouts are redistributed into level 0.
+   Cascades of higher levels follow the same pattern.  Callouts
+   due further out than the wheel spans are parked in the last
+   level and cascaded again until they come within range. */
+#define WHEEL_BITS 6                            /* Bits per level. */
+#define WHEEL_SIZE (1 << WHEEL_BITS)            /* Slots per level. */
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4                          /* Number of levels. */
+#define WHEEL_SPAN (1 << (WHEEL_BITS * WHEEL_LEVELS))
+
+static struct list wheel[WHEEL_LEVELS][WHEEL_SIZE];
+
+/* Next tick whose level-0 slot has not yet been expired. */
+static int64_t wheel_time;
+
+/* True while wheel_advance() is expiring the level-0 slot for
+   WHEEL_TIME, so that a callout scheduled then for the current
+   tick goes into the next slot instead of being expired again in
+   the same pass. */
+static bool wheel_draining;
+
+/* Expired callouts without CALLOUT_IRQ, waiting to be called by
+   the softclock thread, and a semaphore upped for each one. */
+static struct list softclock_list;
+static struct semaphore softclock_sema;
 
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
-/* Number of loops per timer tick.
-   Initialized by timer_calibrate(). */
-static unsigned loops_per_tick;
+/* If false (default), the timer interrupts TIMER_FREQ times per
+   second.  If true, the idle thread reprograms the timer to
+   interrupt only when the next sleeper is due.
+   Controlled by kernel command-line option "-tickless". */
+bool timer_tickless;
+
+/* While tickless, the number of ticks that will have elapsed when
+   the pending one-shot count expires, or 0 if the timer is in
+   its usual periodic mode. */
+static int tickless_ticks;
+static uint16_t tickless_count;         /* Initial one-shot count. */
+static uint16_t tickless_first;         /* Count until first tick. */
+static int64_t skipped_ticks;           /* # of interrupts avoided. */
+
+/* Nanoseconds per timer tick. */
+#define NS_PER_TICK (1000000000 / TIMER_FREQ)
+
+/* Number of ticks over which timer_calibrate() counts TSC
+   cycles. */
+#define CALIBRATE_TICKS 10
+
+/* TSC cycles per second, and the TSC value and time in ns at
+   which timer_calibrate() finished counting.  TSC_HZ is 0 until
+   then. */
+static uint64_t tsc_hz;
+static uint64_t tsc_base;
+static int64_t ns_base;
 
 static intr_handler_func timer_interrupt;
-static bool too_many_loops (unsigned loops);
-static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
+static void wheel_add (struct callout *);
+static void wheel_advance (void);
+static int wheel_idle_ticks (int max);
+static void advance_ticks (int);
+static void pit_periodic (void);
+static void pit_one_shot (uint16_t count);
+static uint16_t pit_read (void);
+static bool pit_expired (void);
+static bool pic_timer_pending (void);
+static void softclock (void *aux);
+static void wake_up (void *thread);
 
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
    interrupt PIT_FREQ times per second, and registers the
@@ -39,44 +111,54 @@ static void real_time_sleep (int64_t num, int32_t denom);
 void
 timer_init (void) 
 {
-  /* 8254 input frequency divided by TIMER_FREQ, rounded to
-     nearest. */
-  uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
-
-  outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
-  outb (0x40, count & 0xff);
-  outb (0x40, count >> 8);
+  int level, slot;
 
+  pit_periodic ();
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 
-  list_init(&sleep_list); 
+  for (level = 0; level < WHEEL_LEVELS; level++)
+    for (slot = 0; slot < WHEEL_SIZE; slot++)
+      list_init (&wheel[level][slot]);
+  wheel_time = 1;
+  list_init (&softclock_list);
+  sema_init (&softclock_sema, 0);
+}
+
+/* Starts the softclock thread, which calls expired callouts that
+   do not have CALLOUT_IRQ.  Callouts may be scheduled earlier, but
+   such callouts are not called until this has been done. */
+void
+timer_start (void) 
+{
+  thread_create ("softclock", PRI_MAX, softclock, NULL);
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* Measures the TSC frequency against the timer, for timer_ns()
+   and brief delays. */
 void
 timer_calibrate (void) 
 {
-  unsigned high_bit, test_bit;
+  int64_t start;
+  uint64_t cycles;
 
   ASSERT (intr_get_level () == INTR_ON);
   printf ("Calibrating timer...  ");
 
-  /* Approximate loops_per_tick as the largest power-of-two
-     still less than one timer tick. */
-  loops_per_tick = 1u << 10;
-  while (!too_many_loops (loops_per_tick << 1)) 
-    {
-      loops_per_tick <<= 1;
-      ASSERT (loops_per_tick != 0);
-    }
+  /* Count cycles from one tick to CALIBRATE_TICKS ticks later. */
+  start = ticks;
+  while (ticks == start)
+    barrier ();
+  start = ticks;
+  cycles = rdtsc ();
+  while (ticks < start + CALIBRATE_TICKS)
+    barrier ();
+  cycles = rdtsc () - cycles;
 
-  /* Refine the next 8 bits of loops_per_tick. */
-  high_bit = loops_per_tick;
-  for (test_bit = high_bit >> 1; test_bit != high_bit >> 10; test_bit >>= 1)
-    if (!too_many_loops (high_bit | test_bit))
-      loops_per_tick |= test_bit;
+  tsc_base = rdtsc ();
+  ns_base = ticks * NS_PER_TICK;
+  tsc_hz = cycles * TIMER_FREQ / CALIBRATE_TICKS;
 
-  printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+  printf ("%'"PRIu64" cycles/s.\n", tsc_hz);
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -98,31 +180,58 @@ timer_elapsed (int64_t then)
   return timer_ticks () - then;
 }
 
-static bool wakeup_ord(const struct list_elem* x, const struct list_elem* y, void* aux UNUSED)
+/* Returns the number of nanoseconds since the OS booted, from
+   the TSC.  Until timer_calibrate() has run, the resolution is
+   only one timer tick. */
+int64_t
+timer_ns (void) 
+{
+  if (tsc_hz == 0)
+    return timer_ticks () * NS_PER_TICK;
+  return ns_base + timer_cycles_to_ns (rdtsc () - tsc_base);
+}
+
+/* Converts CYCLES, a number of TSC cycles, to nanoseconds.
+   Returns 0 until timer_calibrate() has run. */
+int64_t
+timer_cycles_to_ns (uint64_t cycles) 
 {
-  const struct thread* tx = list_entry(x, struct thread, wakeup_elem);
-  const struct thread* ty = list_entry(y, struct thread, wakeup_elem);
+  if (tsc_hz == 0)
+    return 0;
 
-  return (tx->wakeup_time < ty->wakeup_time);
+  /* Split the conversion so that the product cannot overflow. */
+  return (cycles / tsc_hz) * 1000000000
+         + (cycles % tsc_hz) * 1000000000 / tsc_hz;
 }
 
-/* Suspends execution for approximately TICKS timer ticks. */
+/* Suspends execution for approximately TICKS timer ticks.
+   Returns immediately if TICKS is zero or negative. */
 void
 timer_sleep (int64_t ticks) 
 {
-  int64_t wakeup_time = timer_ticks () + ticks;
-  struct thread *t = thread_current();
+  struct thread *t = thread_current ();
   enum intr_level old_level;
 
-  old_level = intr_disable();
+  ASSERT (!intr_context ());
 
-  t->wakeup_time = wakeup_time;
-  list_insert_ordered(&sleep_list, &t->wakeup_elem, wakeup_ord, NULL);
-  thread_block();
+  if (ticks <= 0)
+    return;
 
+  old_level = intr_disable ();
+  callout_init (&t->sleep_callout, wake_up, t, CALLOUT_IRQ);
+  timer_schedule (&t->sleep_callout, ticks);
+  thread_block ();
   intr_set_level (old_level);
 }
 
+/* Callout function that wakes up sleeping THREAD.  Normally
+   wheel_advance() wakes sleepers in a batch instead. */
+static void
+wake_up (void *thread) 
+{
+  thread_unblock (thread);
+}
+
 /* Suspends execution for approximately MS milliseconds. */
 void
 timer_msleep (int64_t ms) 
@@ -144,68 +253,386 @@ timer_nsleep (int64_t ns)
   real_time_sleep (ns, 1000 * 1000 * 1000);
 }
 
+/* Initializes callout C to call FUNC, passing AUX, with the
+   given CALLOUT_* FLAGS.  C is not scheduled. */
+void
+callout_init (struct callout *c, callout_func *func, void *aux,
+              unsigned flags) 
+{
+  ASSERT (c != NULL);
+  ASSERT (func != NULL);
+
+  c->func = func;
+  c->aux = aux;
+  c->flags = flags;
+  c->period = 0;
+  c->pending = false;
+}
+
+/* Schedules callout C to be called once, TICKS timer ticks from
+   now, or on the next tick if TICKS is zero or negative.  If C
+   was already scheduled, it is rescheduled.
+
+   This function may be called from an interrupt handler. */
+void
+timer_schedule (struct callout *c, int64_t ticks) 
+{
+  enum intr_level old_level = intr_disable ();
+
+  if (c->pending)
+    list_remove (&c->elem);
+  c->period = 0;
+  c->expires = timer_ticks () + ticks;
+  wheel_add (c);
+  intr_set_level (old_level);
+}
+
+/* Schedules callout C to be called every PERIOD timer ticks,
+   starting PERIOD ticks from now.  If C was already scheduled,
+   it is rescheduled.
+
+   This function may be called from an interrupt handler. */
+void
+timer_schedule_periodic (struct callout *c, int64_t period) 
+{
+  enum intr_level old_level;
+
+  ASSERT (period > 0);
+
+  old_level = intr_disable ();
+  timer_schedule (c, period);
+  c->period = period;
+  intr_set_level (old_level);
+}
+
+/* Cancels callout C, so that it will not be called again.
+   Returns true if C was pending, false if it was not scheduled
+   or had already expired.  In the latter case, a callout without
+   CALLOUT_IRQ may still be running in the softclock thread.
+
+   This function may be called from an interrupt handler. */
+bool
+timer_cancel (struct callout *c) 
+{
+  enum intr_level old_level = intr_disable ();
+  bool pending = c->pending;
+
+  if (pending)
+    list_remove (&c->elem);
+  c->pending = false;
+  c->period = 0;
+  intr_set_level (old_level);
+
+  return pending;
+}
+
 /* Prints timer statistics. */
 void
 timer_print_stats (void) 
 {
   printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  if (timer_tickless)
+    printf ("Timer: %"PRId64" ticks without interrupt while idle\n",
+            skipped_ticks);
+}
+
+/* Called by the idle thread, with interrupts off, just before it
+   halts the CPU.  In tickless mode, if no sleeper is due in the
+   next few ticks, switches the PIT to a one-shot count that
+   expires on the first tick that has work to do.  The 16-bit
+   PIT count limits this to about 55 ms at a time.
+
+   A timer interrupt that is already latched in the PIC, or that
+   is about to be, would be delivered as the end of the one-shot
+   count and credit all of its ticks at once, so in that case we
+   stay periodic. */
+void
+timer_enter_idle (void) 
+{
+  uint16_t remaining;
+  int skip;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!timer_tickless || tickless_ticks != 0)
+    return;
+
+  remaining = pit_read ();
+  if (remaining < PIT_IDLE_MARGIN || pic_timer_pending ())
+    return;
+  skip = wheel_idle_ticks ((0xffff - remaining) / PIT_TICK_COUNT);
+  if (skip == 0)
+    return;
+
+  tickless_ticks = skip + 1;
+  tickless_first = remaining;
+  tickless_count = remaining + skip * PIT_TICK_COUNT;
+  pit_one_shot (tickless_count);
+}
+
+/* Called on entry to each external interrupt other than the
+   timer's.  If the PIT is counting down a tickless idle period,
+   credits the ticks that have already passed and arranges for a
+   timer interrupt on the next tick boundary, so that the woken
+   thread sees ordinary ticks and time slices. */
+void
+timer_exit_idle (void) 
+{
+  unsigned elapsed, passed, next;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* If the count has already expired, the pending timer
+     interrupt will take care of everything. */
+  if (tickless_ticks == 0 || pit_expired ())
+    return;
+
+  elapsed = tickless_count - pit_read ();
+  passed = elapsed < tickless_first
+           ? 0 : 1 + (elapsed - tickless_first) / PIT_TICK_COUNT;
+  next = tickless_first + passed * PIT_TICK_COUNT;
+  if (next <= elapsed || passed + 1 >= (unsigned) tickless_ticks)
+    return;
+
+  tickless_ticks = 1;
+  tickless_first = tickless_count = next - elapsed;
+  pit_one_shot (tickless_count);
+  skipped_ticks += passed;
+  advance_ticks (passed);
+}
+
+/* Timer interrupt handler. */
+static void
+timer_interrupt (struct intr_frame *args UNUSED)
+{
+  int n = 1;
+
+  if (tickless_ticks != 0) 
+    {
+      n = tickless_ticks;
+      tickless_ticks = 0;
+      skipped_ticks += n - 1;
+      pit_periodic ();
+    }
+  advance_ticks (n);
+}
+
+/* Advances the tick count by N ticks, charging each one to the
+   running thread and expiring the callouts that are due. */
+static void
+advance_ticks (int n) 
+{
+  while (n-- > 0) 
+    {
+      ticks++;
+      thread_tick ();
+      while (wheel_time <= ticks)
+        wheel_advance ();
+    }
 }
 
+/* Adds callout C to the timer wheel, in the slot for
+   C->expires, and marks it pending.  Interrupts must be off. */
 static void
-thread_wakeup (void)
-{
-  struct thread *t;
-  while(!list_empty(&sleep_list)) {
-    t = list_entry(list_front(&sleep_list), struct thread, wakeup_elem);
-    if (t->wakeup_time <= ticks) {
-      list_pop_front(&sleep_list);
-      thread_unblock(t);
-    } else {
+wheel_add (struct callout *c) 
+{
+  int64_t earliest = wheel_draining ? wheel_time + 1 : wheel_time;
+  int64_t expires = c->expires;
+  int64_t delta;
+  int level;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* Already due: expire on the earliest tick not yet expired. */
+  if (expires < earliest)
+    expires = earliest;
+  delta = expires - wheel_time;
+  if (delta >= WHEEL_SPAN) 
+    {
+      /* Too far out: park in the last level until it's closer. */
+      expires = wheel_time + WHEEL_SPAN - 1;
+      delta = WHEEL_SPAN - 1;
+    }
+
+  for (level = 0; level < WHEEL_LEVELS - 1; level++)
+    if (delta < 1 << (WHEEL_BITS * (level + 1)))
       break;
+  list_push_back (&wheel[level][(expires >> (WHEEL_BITS * level))
+                                & WHEEL_MASK],
+                  &c->elem);
+  c->pending = true;
+}
+
+/* Expires tick WHEEL_TIME, first cascading higher levels if the
+   level-0 index has wrapped around, then expiring every callout
+   in the level-0 slot for the tick.  Callouts with CALLOUT_IRQ
+   are called here; the rest are handed to the softclock
+   thread.  Sleepers due on the tick are woken together, with at
+   most one reschedule, instead of by calling wake_up() on each
+   one. */
+static void
+wheel_advance (void) 
+{
+  struct list *slot = &wheel[0][wheel_time & WHEEL_MASK];
+  struct list sleepers;
+  int level;
+
+  list_init (&sleepers);
+
+  for (level = 1; level < WHEEL_LEVELS; level++) 
+    {
+      int index = (wheel_time >> (WHEEL_BITS * level)) & WHEEL_MASK;
+      struct list *upper = &wheel[level][index];
+
+      /* Cascade only on wrap-around at each lower level. */
+      if ((wheel_time & ((1 << (WHEEL_BITS * level)) - 1)) != 0)
+        break;
+      while (!list_empty (upper))
+        wheel_add (list_entry (list_pop_front (upper),
+                               struct callout, elem));
+    }
+
+  wheel_draining = true;
+  while (!list_empty (slot)) 
+    {
+      struct callout *c = list_entry (list_pop_front (slot),
+                                      struct callout, elem);
+      if (c->flags & CALLOUT_IRQ) 
+        {
+          /* Re-arm first, so that C's function can cancel it. */
+          c->pending = false;
+          if (c->period != 0) 
+            {
+              c->expires += c->period;
+              wheel_add (c);
+            }
+          if (c->func == wake_up) 
+            {
+              struct thread *t = c->aux;
+              list_push_back (&sleepers, &t->elem);
+            }
+          else
+            c->func (c->aux);
+        }
+      else 
+        {
+          list_push_back (&softclock_list, &c->elem);
+          sema_up (&softclock_sema);
+        }
     }
-  }
+  wheel_draining = false;
+  thread_unblock_all (&sleepers);
+  wheel_time++;
 }
 
-/* Timer interrupt handler. */
+/* Softclock thread.  Calls expired callouts that lack
+   CALLOUT_IRQ, one at a time, and re-arms periodic ones after
+   their function returns.  A one-shot callout may be freed by its
+   own function. */
 static void
-timer_interrupt (struct intr_frame *args UNUSED)
+softclock (void *aux UNUSED) 
 {
-  ticks++;
-  thread_tick ();
-  thread_wakeup();
+  for (;;) 
+    {
+      enum intr_level old_level;
+      struct callout *c;
+      bool periodic;
+
+      sema_down (&softclock_sema);
+
+      /* The list may be short of the semaphore's count if a
+         queued callout was cancelled. */
+      old_level = intr_disable ();
+      if (list_empty (&softclock_list)) 
+        {
+          intr_set_level (old_level);
+          continue;
+        }
+      c = list_entry (list_pop_front (&softclock_list), struct callout, elem);
+      c->pending = false;
+      periodic = c->period != 0;
+      intr_set_level (old_level);
+
+      c->func (c->aux);
+
+      if (periodic) 
+        {
+          old_level = intr_disable ();
+          if (c->period != 0 && !c->pending) 
+            {
+              c->expires += c->period;
+              wheel_add (c);
+            }
+          intr_set_level (old_level);
+        }
+    }
 }
 
-/* Returns true if LOOPS iterations waits for more than one timer
-   tick, otherwise false. */
-static bool
-too_many_loops (unsigned loops) 
+/* Returns the number of ticks, up to MAX, starting at WHEEL_TIME,
+   on which the timer wheel has nothing to do. */
+static int
+wheel_idle_ticks (int max) 
 {
-  /* Wait for a timer tick. */
-  int64_t start = ticks;
-  while (ticks == start)
-    barrier ();
+  int n;
 
-  /* Run LOOPS loops. */
-  start = ticks;
-  busy_wait (loops);
+  for (n = 0; n < max; n++) 
+    {
+      int64_t tick = wheel_time + n;
+      if ((tick & WHEEL_MASK) == 0
+          || !list_empty (&wheel[0][tick & WHEEL_MASK]))
+        break;
+    }
+  return n;
+}
 
-  /* If the tick count changed, we iterated too long. */
-  barrier ();
-  return start != ticks;
+/* Sets up the 8254 Programmable Interval Timer (PIT) to
+   interrupt TIMER_FREQ times per second. */
+static void
+pit_periodic (void) 
+{
+  outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
+  outb (0x40, PIT_TICK_COUNT & 0xff);
+  outb (0x40, PIT_TICK_COUNT >> 8);
 }
 
-/* Iterates through a simple loop LOOPS times, for implementing
-   brief delays.
+/* Sets up the PIT to interrupt once, COUNT PIT cycles from now. */
+static void
+pit_one_shot (uint16_t count) 
+{
+  outb (0x43, 0x30);    /* CW: counter 0, LSB then MSB, mode 0, binary. */
+  outb (0x40, count & 0xff);
+  outb (0x40, count >> 8);
+}
 
-   Marked NO_INLINE because code alignment can significantly
-   affect timings, so that if this function was inlined
-   differently in different places the results would be difficult
-   to predict. */
-static void NO_INLINE
-busy_wait (int64_t loops) 
+/* Returns the current value of PIT counter 0. */
+static uint16_t
+pit_read (void) 
 {
-  while (loops-- > 0)
-    barrier ();
+  uint8_t lo, hi;
+
+  outb (0x43, 0x00);    /* CW: latch counter 0. */
+  lo = inb (0x40);
+  hi = inb (0x40);
+  return lo | (hi << 8);
+}
+
+/* Returns true if a one-shot count on PIT counter 0 has reached
+   terminal count, according to the counter's OUT pin. */
+static bool
+pit_expired (void) 
+{
+  outb (0x43, 0xe2);    /* Read-back: status of counter 0. */
+  return (inb (0x40) & 0x80) != 0;
+}
+
+/* Returns true if IRQ 0, the timer interrupt, has been raised
+   but not yet delivered, according to the master PIC's interrupt
+   request register. */
+static bool
+pic_timer_pending (void) 
+{
+  outb (0x20, 0x0a);    /* OCW3: read IRR. */
+  return (inb (0x20) & 0x01) != 0;
 }
 
 /* Sleep for approximately NUM/DENOM seconds. */
@@ -230,11 +657,14 @@ real_time_sleep (int64_t num, int32_t denom)
     }
   else 
     {
-      /* Otherwise, use a busy-wait loop for more accurate
-         sub-tick timing.  We scale the numerator and denominator
-         down by 1000 to avoid the possibility of overflow. */
-      ASSERT (denom % 1000 == 0);
-      busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000)); 
+      /* Otherwise, spin on the TSC for more accurate sub-tick
+         timing. */
+      int64_t end;
+
+      ASSERT (1000000000 % denom == 0);
+      end = timer_ns () + num * (1000000000 / denom);
+      while (timer_ns () < end)
+        barrier ();
     }
 }
 
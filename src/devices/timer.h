@@ -1,23 +1,76 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
+/* Function called when a callout expires. */
+typedef void callout_func (void *aux);
+
+/* Callout flags. */
+#define CALLOUT_IRQ 0x1         /* Run in the timer interrupt. */
+
+/* A callout: a function to call once, or periodically, after a
+   given number of timer ticks.
+
+   By default the function runs in the "softclock" kernel thread,
+   which runs callouts one at a time at PRI_MAX.  It may sleep,
+   but that delays any other callout that is due meanwhile.  With
+   CALLOUT_IRQ the function runs in the timer interrupt handler
+   instead, so it must not sleep. */
+struct callout
+  {
+    struct list_elem elem;      /* Timer wheel or softclock list element. */
+    int64_t expires;            /* Tick on which it is due. */
+    int64_t period;             /* Ticks between calls, 0 if one-shot. */
+    callout_func *func;         /* Function to call. */
+    void *aux;                  /* Argument to FUNC. */
+    unsigned flags;             /* CALLOUT_* flags. */
+    bool pending;               /* Scheduled but not yet called? */
+  };
+
+/* If true, stop the periodic tick while idle.
+   Controlled by kernel command-line option "-tickless". */
+extern bool timer_tickless;
+
 void timer_init (void);
+void timer_start (void);
 void timer_calibrate (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+int64_t timer_ns (void);
+int64_t timer_cycles_to_ns (uint64_t cycles);
+
+/* Reads the CPU's time-stamp counter.
+   See [IA32-v2b] "RDTSC". */
+static inline uint64_t
+rdtsc (void) 
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
 
 void timer_sleep (int64_t ticks);
 void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
 
+void callout_init (struct callout *, callout_func *, void *aux,
+                   unsigned flags);
+void timer_schedule (struct callout *, int64_t ticks);
+void timer_schedule_periodic (struct callout *, int64_t period);
+bool timer_cancel (struct callout *);
+
 void timer_print_stats (void);
 
+void timer_enter_idle (void);
+void timer_exit_idle (void);
+
 #endif /* devices/timer.h */
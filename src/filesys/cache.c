@@ -1,29 +1,52 @@
 #include "filesys/cache.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/workqueue.h"
+
+/* Cache entries are a little over 512 bytes, which malloc()
+   would round up to 1 kB. */
+static struct kmem_cache *entry_cache;
+
+/* Periodically submits write_behind_work, which writes dirty
+   blocks back to disk. */
+static struct callout write_behind_callout;
+static struct work write_behind_work;
+
+static void write_behind_tick (void *aux);
+static void write_behind (void *aux);
 
 void cache_init (void) {
     list_init(&cache_list);
-    lock_init(&cache_lock);
+    lock_init_named(&cache_lock, "cache");
     cache_size = 0;
-    thread_create("cache_write_behind_thread", PRI_MIN, write_behind_thread, NULL);
+    entry_cache = kmem_cache_create("cache_entry", sizeof(struct cache_entry), 0, NULL);
+    work_init(&write_behind_work, write_behind, NULL, PRI_MIN);
+    callout_init(&write_behind_callout, write_behind_tick, NULL, CALLOUT_IRQ);
+    timer_schedule_periodic(&write_behind_callout, WRITE_BEHIND_INTERVAL);
 }
 /*
+struct read_ahead {
+    struct work work;
+    disk_sector_t sector;
+};
+
 void cache_read_ahead (disk_sector_t s) {
-    disk_sector_t *args = malloc(sizeof(disk_sector_t));
-    if (args != NULL) {
-        *args = s + 1;
-        thread_create("cache_read_ahead_thread", PRI_MIN, read_ahead_thread, args);
+    struct read_ahead *ra = malloc(sizeof(struct read_ahead));
+    if (ra != NULL) {
+        ra->sector = s + 1;
+        work_init(&ra->work, read_ahead_work, ra, PRI_MIN);
+        work_submit(&system_wq, &ra->work);
     }
 }
 
-void read_ahead_thread (void *aux) {
-    disk_sector_t s = *(disk_sector_t *)aux;
-    struct cache_entry *ce = find_cache_block(s);
+void read_ahead_work (void *aux) {
+    struct read_ahead *ra = aux;
+    struct cache_entry *ce = find_cache_block(ra->sector);
     if (ce == NULL) {
-        ce = cache_load(s);
+        ce = cache_load(ra->sector);
         ce->open_cnt = 0;
     }
-    free(aux);
+    free(ra);
 }
 */
 void cache_write_behind (bool halt) {
@@ -40,17 +63,28 @@ void cache_write_behind (bool halt) {
         }
         if (halt) {
             list_remove(elem);
-            free(ce);
+            kmem_cache_free(entry_cache, ce);
         }
         elem = next;
     }
 }
 
-void write_behind_thread (void *aux UNUSED) {
-    while (true) {
-        timer_sleep(WRITE_BEHIND_INTERVAL);
-        cache_write_behind(false);
-    }
+/* Write-behind callout, run in the timer interrupt. */
+static void write_behind_tick (void *aux UNUSED) {
+    work_submit(&system_wq, &write_behind_work);
+}
+
+/* Write-behind work, run by a system_wq worker at PRI_MIN.  The
+   MLFQS ignores that, so there we make the worker as nice as
+   possible for the duration instead. */
+static void write_behind (void *aux UNUSED) {
+    int nice = thread_get_nice();
+
+    if (thread_mlfqs)
+        thread_set_nice(NICE_MAX);
+    cache_write_behind(false);
+    if (thread_mlfqs)
+        thread_set_nice(nice);
 }
 
 struct cache_entry *find_cache_block(disk_sector_t s) {
@@ -76,7 +110,7 @@ void free_cache_block (disk_sector_t s) {
         ce = list_entry(elem, struct cache_entry, elem);
         if (ce->sector == s) {
             list_remove(elem);
-            free(ce);
+            kmem_cache_free(entry_cache, ce);
             break;
         }
         elem = list_next(elem);
@@ -101,7 +135,7 @@ struct cache_entry *cache_load(disk_sector_t s) {
                         disk_write(filesys_disk, ce->sector, (void *)&ce->block);
                     }
                     list_remove(&ce->elem);
-                    free(ce);
+                    kmem_cache_free(entry_cache, ce);
                     cache_size--;
                     break;
                 }
@@ -113,7 +147,7 @@ struct cache_entry *cache_load(disk_sector_t s) {
         }
         
         cache_size++;
-        c = malloc(sizeof(struct cache_entry));
+        c = kmem_cache_alloc(entry_cache);
         if (c == NULL) {
             cache_size--;
             return NULL;
@@ -27,9 +27,8 @@ struct cache_entry {
 
 void cache_init (void);
 //void cache_read_ahead (disk_sector_t s);
-//void read_ahead_thread (void *aux);
+//void read_ahead_work (void *aux);
 void cache_write_behind (bool halt);
-void write_behind_thread (void *aux);
 struct cache_entry *find_cache_block(disk_sector_t s);
 void free_cache_block (disk_sector_t s);
 struct cache_entry *cache_load(disk_sector_t s);
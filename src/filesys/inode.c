@@ -6,7 +6,10 @@
 #include "filesys/filesys.h"
 #include "filesys/cache.h"
 #include "filesys/free-map.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -54,6 +57,8 @@ struct inode
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    struct rwlock rwlock;               /* Protects DATA. */
+    struct rwlock dir_lock;             /* Protects directory entries. */
     struct inode_disk data;             /* Inode content. */
   };
 
@@ -286,14 +291,37 @@ inode_expand (struct inode_disk *disk_inode, off_t size)
 }
 
 /* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
+   returns the same `struct inode'.  Searching the list needs only
+   shared access to open_inodes_lock. */
 static struct list open_inodes;
+static struct rwlock open_inodes_lock;
+
+/* Cache of `struct inode's. */
+static struct kmem_cache *inode_cache;
+
+static struct inode *find_open_inode (disk_sector_t);
+static void inode_ctor (void *);
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
   list_init (&open_inodes);
+  rwlock_init (&open_inodes_lock);
+  inode_cache = kmem_cache_create ("inode", sizeof (struct inode), 0,
+                                   inode_ctor);
+}
+
+/* Constructs a `struct inode' in INODE_CACHE.  An inode's locks
+   are free whenever the inode is, so they need to be initialized
+   only once. */
+static void
+inode_ctor (void *inode_) 
+{
+  struct inode *inode = inode_;
+
+  rwlock_init (&inode->rwlock);
+  rwlock_init (&inode->dir_lock);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -356,42 +384,71 @@ inode_create (disk_sector_t sector, off_t length, bool isdir)
 struct inode *
 inode_open (disk_sector_t sector) 
 {
-  struct list_elem *e;
-  struct inode *inode;
+  struct inode *inode, *open;
 
   /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
-    {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
-    }
+  rwlock_acquire_read (&open_inodes_lock);
+  inode = inode_reopen (find_open_inode (sector));
+  rwlock_release_read (&open_inodes_lock);
+  if (inode != NULL)
+    return inode;
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = kmem_cache_alloc (inode_cache);
   if (inode == NULL)
     return NULL;
 
   /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
   disk_read (filesys_disk, inode->sector, &inode->data);
+
+  /* Another thread may have opened the same inode while we were
+     reading it. */
+  rwlock_acquire_write (&open_inodes_lock);
+  open = inode_reopen (find_open_inode (sector));
+  if (open == NULL)
+    list_push_front (&open_inodes, &inode->elem);
+  rwlock_release_write (&open_inodes_lock);
+
+  if (open != NULL) 
+    {
+      kmem_cache_free (inode_cache, inode);
+      return open;
+    }
   return inode;
 }
 
-/* Reopens and returns INODE. */
+/* Returns the open inode for SECTOR, or a null pointer if there
+   is none.  open_inodes_lock must be held. */
+static struct inode *
+find_open_inode (disk_sector_t sector) 
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
+       e = list_next (e)) 
+    {
+      struct inode *inode = list_entry (e, struct inode, elem);
+      if (inode->sector == sector) 
+        return inode;
+    }
+  return NULL;
+}
+
+/* Reopens and returns INODE.  Openers may hold open_inodes_lock
+   only for reading, so the count is updated atomically. */
 struct inode *
 inode_reopen (struct inode *inode)
 {
-  if (inode != NULL)
-    inode->open_cnt++;
+  if (inode != NULL) 
+    {
+      enum intr_level old_level = intr_disable ();
+      inode->open_cnt++;
+      intr_set_level (old_level);
+    }
   return inode;
 }
 
@@ -408,17 +465,30 @@ inode_get_inumber (const struct inode *inode)
 void
 inode_close (struct inode *inode) 
 {
+  enum intr_level old_level;
+  bool last;
+
   /* Ignore null pointer. */
   if (inode == NULL)
     return;
 
-  /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  /* Release resources if this was the last opener.  Write the
+     inode back before taking it off the open list, so that a
+     concurrent inode_open() of the same sector either finds it
+     on the list or reads the up-to-date copy from disk. */
+  rwlock_acquire_write (&open_inodes_lock);
+  old_level = intr_disable ();
+  last = --inode->open_cnt == 0;
+  intr_set_level (old_level);
+  if (last) 
     {
-      /* Remove from inode list and release lock. */
+      disk_write (filesys_disk, inode->sector, &inode->data);
       list_remove (&inode->elem);
+    }
+  rwlock_release_write (&open_inodes_lock);
 
-      disk_write(filesys_disk, inode->sector, &inode->data);
+  if (last)
+    {
       /* Deallocate blocks if removed. */
       if (inode->removed) 
         {
@@ -495,7 +565,7 @@ inode_close (struct inode *inode)
                             bytes_to_sectors (inode->data.length)); 
 */          
         }
-      free (inode); 
+      kmem_cache_free (inode_cache, inode);
     }
 }
 
@@ -517,6 +587,7 @@ inode_read_at(struct inode *inode, void *buffer_, off_t size, off_t offset)
 	uint8_t *buffer = buffer_;
 	off_t bytes_read = 0;
 
+	rwlock_acquire_read(&inode->rwlock);
 	while (size > 0)
 	{
 		/* Disk sector to read, starting byte offset within sector. */
@@ -540,6 +611,7 @@ inode_read_at(struct inode *inode, void *buffer_, off_t size, off_t offset)
 		offset += chunk_size;
 		bytes_read += chunk_size;
 	}
+	rwlock_release_read(&inode->rwlock);
 
 	return bytes_read;
 }
@@ -559,8 +631,16 @@ off_t offset)
 	if (inode->deny_write_cnt)
 		return 0;
 
+        rwlock_acquire_read(&inode->rwlock);
         if (inode->data.length < size + offset) {
-            inode_expand(&inode->data, (off_t)(size + offset - inode->data.length));
+            /* Growing the file changes the inode's data, which needs
+               exclusive access.  Recheck the length in case another
+               writer grew it while we waited. */
+            if (!rwlock_upgrade(&inode->rwlock))
+                rwlock_acquire_write(&inode->rwlock);
+            if (inode->data.length < size + offset)
+                inode_expand(&inode->data, (off_t)(size + offset - inode->data.length));
+            rwlock_downgrade(&inode->rwlock);
         }
 
 	while (size > 0)
@@ -594,6 +674,7 @@ off_t offset)
 		offset += chunk_size;
 		bytes_written += chunk_size;
 	}
+	rwlock_release_read(&inode->rwlock);
 
 	return bytes_written;
 }
@@ -625,6 +706,14 @@ inode_length (const struct inode *inode)
   return inode->data.length;
 }
 
+/* Returns the lock that protects the entries of INODE, if it is
+   a directory.  Lookups need only hold it for reading. */
+struct rwlock *
+inode_dir_lock (struct inode *inode)
+{
+  return &inode->dir_lock;
+}
+
 bool
 inode_isdir (const struct inode *inode)
 {
@@ -182,3 +182,9 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+int
+latency_histogram (unsigned counts[], int cnt) 
+{
+  return syscall2 (SYS_LATENCY, counts, cnt);
+}
@@ -45,4 +45,7 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Scheduler statistics. */
+int latency_histogram (unsigned counts[], int cnt);
+
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,102 @@
+/* Creates a large number of threads that all sleep until the
+   same tick, several times over.  Verifies that every thread
+   wakes up, none of them early, and reports how long it took
+   from the first to the last thread running after each shared
+   wakeup tick.
+
+   Needs more memory than the default, for the threads' pages. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 1000
+#define ITERATIONS 5
+
+/* Information about the test. */
+struct batch_test 
+  {
+    int64_t start;                      /* Current time at start of test. */
+    int woken[ITERATIONS];              /* Threads woken per iteration. */
+    int early;                          /* Threads woken too early. */
+    int64_t first_ns[ITERATIONS];       /* First wakeup per iteration. */
+    int64_t last_ns[ITERATIONS];        /* Last wakeup per iteration. */
+    struct semaphore done;              /* Up'd by each finished thread. */
+  };
+
+static void sleeper (void *);
+
+void
+test_alarm_batch (void) 
+{
+  struct batch_test test;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  msg ("Creating %d threads to sleep %d times each.",
+       THREAD_CNT, ITERATIONS);
+  msg ("Within an iteration, all threads sleep until the same tick.");
+
+  for (i = 0; i < ITERATIONS; i++) 
+    {
+      test.woken[i] = 0;
+      test.first_ns[i] = test.last_ns[i] = 0;
+    }
+  test.early = 0;
+  sema_init (&test.done, 0);
+
+  /* Keep the sleepers from running until they are all created
+     and the start time is set. */
+  thread_set_priority (PRI_MAX);
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "sleeper %d", i);
+      if (thread_create (name, PRI_DEFAULT, sleeper, &test) == TID_ERROR)
+        fail ("could not create thread %d", i);
+    }
+  test.start = timer_ticks () + 10;
+  thread_set_priority (PRI_DEFAULT);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&test.done);
+
+  if (test.early != 0)
+    fail ("%d wakeups came early", test.early);
+  for (i = 0; i < ITERATIONS; i++)
+    msg ("iteration %d: %d threads woke up, the last %lld us after the first",
+         i, test.woken[i], (test.last_ns[i] - test.first_ns[i]) / 1000);
+}
+
+/* Sleeper thread. */
+static void
+sleeper (void *test_) 
+{
+  struct batch_test *test = test_;
+  int i;
+
+  for (i = 0; i < ITERATIONS; i++) 
+    {
+      int64_t sleep_until = test->start + (i + 1) * 10;
+      enum intr_level old_level;
+      int64_t now;
+
+      timer_sleep (sleep_until - timer_ticks ());
+
+      old_level = intr_disable ();
+      now = timer_ns ();
+      if (timer_ticks () < sleep_until)
+        test->early++;
+      if (test->woken[i]++ == 0)
+        test->first_ns[i] = now;
+      test->last_ns[i] = now;
+      intr_set_level (old_level);
+    }
+  sema_up (&test->done);
+}
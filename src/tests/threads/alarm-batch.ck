@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# The wakeup spread depends on the machine, so don't compare it.
+s/, the last \d+ us after the first$// foreach @output;
+
+compare_output ("run", \@output, [<<'EOF']);
+(alarm-batch) begin
+(alarm-batch) Creating 1000 threads to sleep 5 times each.
+(alarm-batch) Within an iteration, all threads sleep until the same tick.
+(alarm-batch) iteration 0: 1000 threads woke up
+(alarm-batch) iteration 1: 1000 threads woke up
+(alarm-batch) iteration 2: 1000 threads woke up
+(alarm-batch) iteration 3: 1000 threads woke up
+(alarm-batch) iteration 4: 1000 threads woke up
+(alarm-batch) end
+EOF
+pass;
@@ -0,0 +1,97 @@
+/* Four threads meet at the same barrier over several
+   generations, arriving in a different order each time.  No
+   thread may leave a generation before all four have arrived,
+   and exactly one thread per generation must be told that it
+   arrived last. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 4
+#define GENERATIONS 5
+
+/* Shared among the threads. */
+struct barrier_test 
+  {
+    struct barrier barrier;
+    struct lock lock;                   /* Protects the rest. */
+    int arrived[GENERATIONS];           /* Arrivals per generation. */
+    int last[GENERATIONS];              /* Arrived-last results. */
+    int early;                          /* Threads that left early. */
+  };
+
+static thread_func meet_func;
+static void meet (struct barrier_test *, int id);
+
+void
+test_barrier_reuse (void) 
+{
+  struct barrier_test test;
+  int i;
+
+  barrier_init (&test.barrier, THREAD_CNT);
+  lock_init (&test.lock);
+  for (i = 0; i < GENERATIONS; i++)
+    test.arrived[i] = test.last[i] = 0;
+  test.early = 0;
+
+  msg ("%d threads meeting at a barrier %d times.", THREAD_CNT, GENERATIONS);
+  for (i = 1; i < THREAD_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "meet %d", i);
+      thread_create (name, PRI_DEFAULT, meet_func, &test);
+    }
+  meet (&test, 0);
+
+  /* One more generation, to wait for the other threads. */
+  barrier_wait (&test.barrier);
+
+  for (i = 0; i < GENERATIONS; i++)
+    msg ("generation %d: %d threads arrived, %d arrived last",
+         i, test.arrived[i], test.last[i]);
+  if (test.early != 0)
+    fail ("%d threads left a generation early", test.early);
+}
+
+static void
+meet_func (void *test_) 
+{
+  struct barrier_test *test = test_;
+  int id = thread_name ()[5] - '0';
+
+  meet (test, id);
+  barrier_wait (&test->barrier);
+}
+
+/* Meets the other threads GENERATIONS times, arriving after a
+   delay that depends on ID and the generation. */
+static void
+meet (struct barrier_test *test, int id) 
+{
+  int g;
+
+  for (g = 0; g < GENERATIONS; g++) 
+    {
+      bool last;
+
+      timer_sleep ((id + g) % THREAD_CNT);
+
+      lock_acquire (&test->lock);
+      test->arrived[g]++;
+      lock_release (&test->lock);
+
+      last = barrier_wait (&test->barrier);
+
+      lock_acquire (&test->lock);
+      if (test->arrived[g] != THREAD_CNT)
+        test->early++;
+      if (last)
+        test->last[g]++;
+      lock_release (&test->lock);
+    }
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(barrier-reuse) begin
+(barrier-reuse) 4 threads meeting at a barrier 5 times.
+(barrier-reuse) generation 0: 4 threads arrived, 1 arrived last
+(barrier-reuse) generation 1: 4 threads arrived, 1 arrived last
+(barrier-reuse) generation 2: 4 threads arrived, 1 arrived last
+(barrier-reuse) generation 3: 4 threads arrived, 1 arrived last
+(barrier-reuse) generation 4: 4 threads arrived, 1 arrived last
+(barrier-reuse) end
+EOF
+pass;
@@ -0,0 +1,52 @@
+/* Several higher-priority threads wait on a completion.
+   Completing it must wake all of them at once, and later waits
+   must not block. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define WAITER_CNT 3
+
+static thread_func waiter_func;
+
+void
+test_completion_wait (void) 
+{
+  struct completion done;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  completion_init (&done);
+  for (i = 0; i < WAITER_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "waiter %d", i);
+      thread_create (name, PRI_DEFAULT + 1, waiter_func, &done);
+    }
+
+  if (completion_done (&done))
+    fail ("Completion done before complete().");
+  msg ("Completing.");
+  complete (&done);
+  msg ("All waiters should have woken up.");
+
+  if (!completion_done (&done))
+    fail ("Completion not done after complete().");
+  completion_wait (&done);
+  msg ("Waiting again returned at once.");
+}
+
+static void
+waiter_func (void *done_) 
+{
+  struct completion *done = done_;
+
+  msg ("Thread %s waiting.", thread_name ());
+  completion_wait (done);
+  msg ("Thread %s woke up.", thread_name ());
+}
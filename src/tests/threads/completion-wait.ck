@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(completion-wait) begin
+(completion-wait) Thread waiter 0 waiting.
+(completion-wait) Thread waiter 1 waiting.
+(completion-wait) Thread waiter 2 waiting.
+(completion-wait) Completing.
+(completion-wait) Thread waiter 0 woke up.
+(completion-wait) Thread waiter 1 woke up.
+(completion-wait) Thread waiter 2 woke up.
+(completion-wait) All waiters should have woken up.
+(completion-wait) Waiting again returned at once.
+(completion-wait) end
+EOF
+pass;
@@ -0,0 +1,56 @@
+/* The main thread waits on a countdown latch that three
+   lower-priority threads count down.  It must not wake up until
+   the last of them has done so. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define COUNTER_CNT 3
+
+/* Shared between the main thread and the counters. */
+struct latch_test 
+  {
+    struct latch latch;
+    int count_downs;            /* Number of count downs so far. */
+  };
+
+static thread_func counter_func;
+
+void
+test_latch_wait (void) 
+{
+  struct latch_test test;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  latch_init (&test.latch, COUNTER_CNT);
+  test.count_downs = 0;
+  for (i = 0; i < COUNTER_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "counter %d", i);
+      thread_create (name, PRI_DEFAULT - 1, counter_func, &test);
+    }
+
+  msg ("Main waiting on latch.");
+  latch_wait (&test.latch);
+  msg ("Main woke up after %d count downs.", test.count_downs);
+
+  latch_wait (&test.latch);
+  msg ("Waiting again returned at once.");
+}
+
+static void
+counter_func (void *test_) 
+{
+  struct latch_test *test = test_;
+
+  msg ("Thread %s counting down.", thread_name ());
+  test->count_downs++;
+  latch_count_down (&test->latch);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(latch-wait) begin
+(latch-wait) Main waiting on latch.
+(latch-wait) Thread counter 0 counting down.
+(latch-wait) Thread counter 1 counting down.
+(latch-wait) Thread counter 2 counting down.
+(latch-wait) Main woke up after 3 count downs.
+(latch-wait) Waiting again returned at once.
+(latch-wait) end
+EOF
+pass;
@@ -0,0 +1,81 @@
+/* The main thread holds a lock that a medium-priority thread
+   waits for while holding a second lock.  A high-priority thread
+   then waits for the second lock with a timeout, which donates
+   its priority through the chain to the main thread.  When the
+   wait times out, the donation must be withdrawn all the way
+   down the chain again. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* How long the high-priority thread waits, in timer ticks. */
+#define TIMEOUT 5
+
+struct locks 
+  {
+    struct lock a;              /* Held by main, wanted by medium. */
+    struct lock b;              /* Held by medium, wanted by high. */
+  };
+
+static thread_func medium_thread_func;
+static thread_func high_thread_func;
+
+void
+test_lock_timeout_donate (void) 
+{
+  struct locks locks;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  lock_init (&locks.a);
+  lock_init (&locks.b);
+  lock_acquire (&locks.a);
+
+  thread_create ("medium", PRI_DEFAULT + 2, medium_thread_func, &locks);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 2, thread_get_priority ());
+
+  thread_create ("high", PRI_DEFAULT + 10, high_thread_func, &locks);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 10, thread_get_priority ());
+
+  timer_sleep (TIMEOUT * 4);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 2, thread_get_priority ());
+
+  lock_release (&locks.a);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+}
+
+static void
+medium_thread_func (void *locks_) 
+{
+  struct locks *locks = locks_;
+
+  lock_acquire (&locks->b);
+  lock_acquire (&locks->a);
+  msg ("Medium thread got lock a with priority %d.",
+       thread_get_priority ());
+  lock_release (&locks->a);
+  lock_release (&locks->b);
+  msg ("Medium thread finished.");
+}
+
+static void
+high_thread_func (void *locks_) 
+{
+  struct locks *locks = locks_;
+
+  if (lock_acquire_timeout (&locks->b, TIMEOUT))
+    fail ("High thread acquired lock b.");
+  msg ("High thread timed out waiting for lock b.");
+}
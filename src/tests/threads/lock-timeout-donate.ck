@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(lock-timeout-donate) begin
+(lock-timeout-donate) Main thread should have priority 33.  Actual priority: 33.
+(lock-timeout-donate) Main thread should have priority 41.  Actual priority: 41.
+(lock-timeout-donate) High thread timed out waiting for lock b.
+(lock-timeout-donate) Main thread should have priority 33.  Actual priority: 33.
+(lock-timeout-donate) Medium thread got lock a with priority 33.
+(lock-timeout-donate) Medium thread finished.
+(lock-timeout-donate) Main thread should have priority 31.  Actual priority: 31.
+(lock-timeout-donate) end
+EOF
+pass;
@@ -0,0 +1,81 @@
+/* Checks that malloc() and free() recycle blocks through the
+   per-size magazine of recently freed blocks: a freed block is
+   handed out again by the next malloc() of the same size, a long
+   run of malloc() and free() pairs takes no pages from the page
+   allocator, and freeing many blocks gives their arenas back. */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+
+#define BLOCK_SIZE 100
+#define BLOCK_CNT 200
+#define LOOP_CNT 1000
+
+/* Arenas that may stay allocated after all the blocks are freed:
+   the magazine's blocks still count as in use, so they can keep
+   up to two partly used arenas, and each size keeps one empty
+   arena. */
+#define SLACK_PAGES 3
+
+static void *blocks[BLOCK_CNT];
+
+static size_t kernel_free_cnt (void);
+
+void
+test_malloc_magazine (void) 
+{
+  size_t start_cnt;
+  uintptr_t freed;
+  void *p;
+  int i;
+
+  p = malloc (BLOCK_SIZE);
+  freed = (uintptr_t) p;
+  free (p);
+  p = malloc (BLOCK_SIZE);
+  if ((uintptr_t) p != freed)
+    fail ("freed block %#"PRIxPTR" not reused, got %p", freed, p);
+  free (p);
+  msg ("A freed block is reused by the next malloc().");
+
+  start_cnt = kernel_free_cnt ();
+  for (i = 0; i < LOOP_CNT; i++) 
+    {
+      p = malloc (BLOCK_SIZE);
+      if (p == NULL)
+        fail ("malloc() failed on iteration %d", i);
+      free (p);
+    }
+  if (kernel_free_cnt () != start_cnt)
+    fail ("%d malloc() and free() pairs changed free pages from %zu to %zu",
+          LOOP_CNT, start_cnt, kernel_free_cnt ());
+  msg ("%d malloc() and free() pairs used no pages.", LOOP_CNT);
+
+  start_cnt = kernel_free_cnt ();
+  for (i = 0; i < BLOCK_CNT; i++) 
+    {
+      blocks[i] = malloc (BLOCK_SIZE);
+      if (blocks[i] == NULL)
+        fail ("malloc() failed on block %d", i);
+    }
+  for (i = BLOCK_CNT - 1; i >= 0; i--)
+    free (blocks[i]);
+  if (kernel_free_cnt () + SLACK_PAGES < start_cnt)
+    fail ("free pages dropped from %zu to %zu after freeing %d blocks",
+          start_cnt, kernel_free_cnt (), BLOCK_CNT);
+  msg ("Freeing %d blocks gave their arenas back.", BLOCK_CNT);
+}
+
+/* Returns the number of free pages in the kernel pool. */
+static size_t
+kernel_free_cnt (void) 
+{
+  size_t free_cnt, used_cnt;
+
+  palloc_get_stats (0, &free_cnt, &used_cnt);
+  return free_cnt;
+}
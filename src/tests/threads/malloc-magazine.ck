@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(malloc-magazine) begin
+(malloc-magazine) A freed block is reused by the next malloc().
+(malloc-magazine) 1000 malloc() and free() pairs used no pages.
+(malloc-magazine) Freeing 200 blocks gave their arenas back.
+(malloc-magazine) end
+EOF
+pass;
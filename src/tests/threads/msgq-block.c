@@ -0,0 +1,81 @@
+/* A higher-priority consumer blocks on an empty message queue
+   until the main thread puts messages into it, and then a
+   higher-priority producer blocks on the same queue while it is
+   full until the main thread takes messages out.  Each message
+   must arrive exactly once and in order. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/msgq.h"
+
+#define QUEUE_CAPACITY 2
+#define MSG_CNT 4
+
+static thread_func consumer_func;
+static thread_func producer_func;
+
+void
+test_msgq_block (void) 
+{
+  void *buf[QUEUE_CAPACITY];
+  struct msgq q;
+  void *extra;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  msgq_init (&q, buf, QUEUE_CAPACITY);
+
+  thread_create ("consumer", PRI_DEFAULT + 1, consumer_func, &q);
+  for (i = 1; i <= MSG_CNT; i++) 
+    {
+      msg ("Main putting %d.", i);
+      msgq_put (&q, (void *) (uintptr_t) i);
+    }
+  if (!msgq_empty (&q))
+    fail ("Queue holds %zu messages after consumer exited.",
+          msgq_count (&q));
+
+  thread_create ("producer", PRI_DEFAULT + 1, producer_func, &q);
+  if (!msgq_full (&q))
+    fail ("Queue holds %zu messages with producer waiting.",
+          msgq_count (&q));
+  msg ("Queue is full.");
+  for (i = 1; i <= MSG_CNT; i++)
+    msg ("Main got %d.", (int) (uintptr_t) msgq_get (&q));
+
+  if (msgq_try_get (&q, &extra))
+    fail ("Got a message from an empty queue.");
+  msg ("Queue is empty.");
+}
+
+static void
+consumer_func (void *q_) 
+{
+  struct msgq *q = q_;
+  int i;
+
+  for (i = 0; i < MSG_CNT; i++) 
+    {
+      msg ("Consumer waiting.");
+      msg ("Consumer got %d.", (int) (uintptr_t) msgq_get (q));
+    }
+}
+
+static void
+producer_func (void *q_) 
+{
+  struct msgq *q = q_;
+  int i;
+
+  for (i = 1; i <= MSG_CNT; i++) 
+    {
+      msg ("Producer putting %d.", i);
+      msgq_put (q, (void *) (uintptr_t) i);
+    }
+  msg ("Producer done.");
+}
@@ -0,0 +1,32 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(msgq-block) begin
+(msgq-block) Consumer waiting.
+(msgq-block) Main putting 1.
+(msgq-block) Consumer got 1.
+(msgq-block) Consumer waiting.
+(msgq-block) Main putting 2.
+(msgq-block) Consumer got 2.
+(msgq-block) Consumer waiting.
+(msgq-block) Main putting 3.
+(msgq-block) Consumer got 3.
+(msgq-block) Consumer waiting.
+(msgq-block) Main putting 4.
+(msgq-block) Consumer got 4.
+(msgq-block) Producer putting 1.
+(msgq-block) Producer putting 2.
+(msgq-block) Producer putting 3.
+(msgq-block) Queue is full.
+(msgq-block) Producer putting 4.
+(msgq-block) Main got 1.
+(msgq-block) Producer done.
+(msgq-block) Main got 2.
+(msgq-block) Main got 3.
+(msgq-block) Main got 4.
+(msgq-block) Queue is empty.
+(msgq-block) end
+EOF
+pass;
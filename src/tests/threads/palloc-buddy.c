@@ -0,0 +1,69 @@
+/* Allocates every free page in the user pool one at a time, then
+   frees them in an order that leaves no two buddies free until
+   half of the pages have been freed.  The buddy allocator must
+   coalesce them again, so that afterward the free page count is
+   back where it started and the largest power-of-2 block that
+   fits in the pool can be allocated in one piece.
+
+   Must be run with "-palloc=buddy". */
+
+#include <round.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+void
+test_palloc_buddy (void) 
+{
+  size_t free_cnt, used_cnt, start_cnt;
+  size_t page_cnt, array_pages, block_cnt;
+  void **pages;
+  void *block;
+  size_t i;
+
+  if (!palloc_buddy)
+    fail ("This test requires -palloc=buddy.");
+
+  palloc_get_stats (PAL_USER, &start_cnt, &used_cnt);
+  array_pages = DIV_ROUND_UP (start_cnt * sizeof *pages, PGSIZE);
+  pages = palloc_get_multiple (PAL_ASSERT, array_pages);
+
+  /* Allocating the last free pages also empties the pool's
+     reserve of zeroed pages, so that afterward every free page is
+     on the buddy free lists. */
+  for (page_cnt = 0; page_cnt < start_cnt; page_cnt++) 
+    {
+      pages[page_cnt] = palloc_get_page (PAL_USER);
+      if (pages[page_cnt] == NULL)
+        break;
+    }
+  if (page_cnt != start_cnt)
+    fail ("allocated %zu of %zu free pages", page_cnt, start_cnt);
+  if (palloc_get_page (PAL_USER) != NULL)
+    fail ("allocated a page from an exhausted pool");
+  msg ("Allocated every free user page one at a time.");
+
+  for (i = 1; i < page_cnt; i += 2)
+    palloc_free_page (pages[i]);
+  for (i = 0; i < page_cnt; i += 2)
+    palloc_free_page (pages[i]);
+  palloc_get_stats (PAL_USER, &free_cnt, &used_cnt);
+  if (free_cnt != start_cnt)
+    fail ("%zu pages free after freeing, expected %zu",
+          free_cnt, start_cnt);
+  msg ("Freed them in scrambled order.");
+
+  for (block_cnt = 1; block_cnt * 2 <= page_cnt; block_cnt *= 2)
+    continue;
+  block = palloc_get_multiple (PAL_USER, block_cnt);
+  if (block == NULL)
+    fail ("could not allocate %zu contiguous pages", block_cnt);
+  palloc_free_multiple (block, block_cnt);
+  msg ("Allocated the largest power-of-2 block.");
+
+  palloc_get_stats (PAL_USER, &free_cnt, &used_cnt);
+  if (free_cnt != start_cnt)
+    fail ("%zu pages free at end, expected %zu", free_cnt, start_cnt);
+  palloc_free_multiple (pages, array_pages);
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(palloc-buddy) begin
+(palloc-buddy) Allocated every free user page one at a time.
+(palloc-buddy) Freed them in scrambled order.
+(palloc-buddy) Allocated the largest power-of-2 block.
+(palloc-buddy) end
+EOF
+pass;
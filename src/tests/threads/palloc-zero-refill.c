@@ -0,0 +1,61 @@
+/* Waits for the page allocator's zeroing thread to fill the
+   kernel pool's reserve of zeroed pages, then makes a request
+   large enough that the reserve must be drained back into the
+   pool, and verifies that the zeroing thread notices and fills
+   the reserve again. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "devices/timer.h"
+
+/* How long to wait for the reserve to fill, in timer ticks. */
+#define FILL_TIMEOUT (10 * TIMER_FREQ)
+
+static bool wait_for_reserve (void);
+
+void
+test_palloc_zero_refill (void) 
+{
+  size_t free_cnt, used_cnt, zeroed_cnt, page_cnt;
+  void *pages;
+
+  if (!wait_for_reserve ())
+    fail ("zeroed reserve never filled");
+  msg ("zeroed reserve filled");
+
+  /* Ask for one page more than lies outside the reserve.  That
+     drains the reserve back into the pool, whether or not there
+     is a long enough run of pages to satisfy the request. */
+  palloc_get_stats (0, &free_cnt, &used_cnt);
+  zeroed_cnt = palloc_zeroed_cnt (0);
+  page_cnt = free_cnt - zeroed_cnt + 1;
+  pages = palloc_get_multiple (0, page_cnt);
+  if (palloc_zeroed_cnt (0) != 0)
+    fail ("%zu-page request left %zu pages in the zeroed reserve",
+          page_cnt, palloc_zeroed_cnt (0));
+  palloc_free_multiple (pages, page_cnt);
+  msg ("zeroed reserve drained");
+
+  if (!wait_for_reserve ())
+    fail ("zeroed reserve was not refilled after being drained");
+  msg ("zeroed reserve refilled");
+}
+
+/* Sleeps until the kernel pool's zeroed reserve is nonempty, for
+   up to FILL_TIMEOUT ticks.  Returns true if it filled, false if
+   the wait timed out. */
+static bool
+wait_for_reserve (void) 
+{
+  int64_t start = timer_ticks ();
+
+  while (palloc_zeroed_cnt (0) == 0) 
+    {
+      if (timer_elapsed (start) > FILL_TIMEOUT)
+        return false;
+      timer_sleep (1);
+    }
+  return true;
+}
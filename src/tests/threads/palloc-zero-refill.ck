@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(palloc-zero-refill) begin
+(palloc-zero-refill) zeroed reserve filled
+(palloc-zero-refill) zeroed reserve drained
+(palloc-zero-refill) zeroed reserve refilled
+(palloc-zero-refill) end
+EOF
+pass;
@@ -0,0 +1,68 @@
+/* The main thread holds a readers-writer lock for reading.  A
+   higher-priority "upgrader" thread also reads, then tries to
+   upgrade, which must wait for the main thread to let go.  A
+   still higher-priority writer then waits to write.  The main
+   thread's own attempt to upgrade must fail, since an upgrade is
+   already pending, and drop its read hold.  That lets the
+   upgrader in ahead of the writer.  The upgrader downgrades,
+   which must not let the writer in until it stops reading. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func upgrader_func;
+static thread_func writer_func;
+
+void
+test_rwlock_upgrade (void) 
+{
+  struct rwlock rwl;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  rwlock_init (&rwl);
+  rwlock_acquire_read (&rwl);
+
+  thread_create ("upgrader", PRI_DEFAULT + 1, upgrader_func, &rwl);
+  thread_create ("writer", PRI_DEFAULT + 2, writer_func, &rwl);
+
+  msg ("Main upgrading while another upgrade is pending.");
+  if (rwlock_upgrade (&rwl))
+    fail ("Main's upgrade should have failed.");
+  msg ("Main's upgrade failed and dropped its read hold.");
+
+  rwlock_acquire_read (&rwl);
+  msg ("Main holds the lock for reading again.");
+  rwlock_release_read (&rwl);
+}
+
+static void
+upgrader_func (void *rwl_) 
+{
+  struct rwlock *rwl = rwl_;
+
+  rwlock_acquire_read (rwl);
+  msg ("Upgrader holds the lock for reading.");
+  if (!rwlock_upgrade (rwl))
+    fail ("Upgrader's upgrade should have succeeded.");
+  msg ("Upgrader holds the lock for writing.");
+  rwlock_downgrade (rwl);
+  msg ("Upgrader downgraded to reading.");
+  rwlock_release_read (rwl);
+  msg ("Upgrader done.");
+}
+
+static void
+writer_func (void *rwl_) 
+{
+  struct rwlock *rwl = rwl_;
+
+  msg ("Writer waiting to write.");
+  rwlock_acquire_write (rwl);
+  msg ("Writer holds the lock for writing.");
+  rwlock_release_write (rwl);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-upgrade) begin
+(rwlock-upgrade) Upgrader holds the lock for reading.
+(rwlock-upgrade) Writer waiting to write.
+(rwlock-upgrade) Main upgrading while another upgrade is pending.
+(rwlock-upgrade) Upgrader holds the lock for writing.
+(rwlock-upgrade) Upgrader downgraded to reading.
+(rwlock-upgrade) Writer holds the lock for writing.
+(rwlock-upgrade) Upgrader done.
+(rwlock-upgrade) Main's upgrade failed and dropped its read hold.
+(rwlock-upgrade) Main holds the lock for reading again.
+(rwlock-upgrade) end
+EOF
+pass;
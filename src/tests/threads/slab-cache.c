@@ -0,0 +1,110 @@
+/* Allocates several slabs' worth of objects from an object cache
+   and checks that they are aligned, do not overlap, and were all
+   constructed.  The constructor must run only when a slab is
+   created, a whole slab at a time, so that freeing objects and
+   allocating them again reuses them in their constructed state
+   without calling it again. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/slab.h"
+
+#define OBJ_CNT 100
+#define OBJ_ALIGN 32
+#define OBJ_MAGIC 0x0b1ec75a
+
+/* An object, about 100 bytes long, so that a slab holds several
+   of them but not all OBJ_CNT. */
+struct obj 
+  {
+    unsigned magic;             /* OBJ_MAGIC once constructed. */
+    bool in_use;                /* False in the constructed state. */
+    int id;                     /* Index into OBJS while in use. */
+    char payload[88];
+  };
+
+static struct obj *objs[OBJ_CNT];
+static unsigned ctor_calls;
+
+static kmem_ctor obj_ctor;
+static struct obj *alloc_obj (struct kmem_cache *, int id);
+static void free_obj (struct kmem_cache *, int id);
+
+void
+test_slab_cache (void) 
+{
+  struct kmem_cache *cache;
+  unsigned per_slab, ctor_before;
+  int i;
+
+  cache = kmem_cache_create ("test", sizeof (struct obj), OBJ_ALIGN,
+                             obj_ctor);
+
+  ctor_calls = 0;
+  alloc_obj (cache, 0);
+  per_slab = ctor_calls;
+  if (per_slab < 2 || per_slab >= OBJ_CNT)
+    fail ("first slab constructed %u objects", per_slab);
+  for (i = 1; i < OBJ_CNT; i++)
+    alloc_obj (cache, i);
+  if (ctor_calls % per_slab != 0
+      || ctor_calls < OBJ_CNT || ctor_calls - OBJ_CNT >= per_slab)
+    fail ("%u constructor calls for %d objects in slabs of %u",
+          ctor_calls, OBJ_CNT, per_slab);
+  for (i = 0; i < OBJ_CNT; i++)
+    if (objs[i]->id != i)
+      fail ("object %d overlaps object %d", i, objs[i]->id);
+  msg ("Allocated %d aligned, distinct, constructed objects.", OBJ_CNT);
+
+  for (i = 0; i < OBJ_CNT; i += 2)
+    free_obj (cache, i);
+  ctor_before = ctor_calls;
+  for (i = 0; i < OBJ_CNT; i += 2)
+    alloc_obj (cache, i);
+  if (ctor_calls != ctor_before)
+    fail ("%u constructor calls reallocating freed objects",
+          ctor_calls - ctor_before);
+  msg ("Reallocated freed objects without constructing them again.");
+
+  for (i = 0; i < OBJ_CNT; i++)
+    free_obj (cache, i);
+}
+
+/* Constructor for struct obj. */
+static void
+obj_ctor (void *obj_) 
+{
+  struct obj *obj = obj_;
+
+  obj->magic = OBJ_MAGIC;
+  obj->in_use = false;
+  ctor_calls++;
+}
+
+/* Allocates an object from CACHE as OBJS[ID] and checks that it
+   is aligned and in its constructed state. */
+static struct obj *
+alloc_obj (struct kmem_cache *cache, int id) 
+{
+  struct obj *obj = kmem_cache_alloc (cache);
+
+  if (obj == NULL)
+    fail ("kmem_cache_alloc() failed for object %d", id);
+  if ((uintptr_t) obj % OBJ_ALIGN != 0)
+    fail ("object %d at %p is misaligned", id, obj);
+  if (obj->magic != OBJ_MAGIC || obj->in_use)
+    fail ("object %d is not in its constructed state", id);
+  obj->in_use = true;
+  obj->id = id;
+  objs[id] = obj;
+  return obj;
+}
+
+/* Returns OBJS[ID] to CACHE in its constructed state. */
+static void
+free_obj (struct kmem_cache *cache, int id) 
+{
+  objs[id]->in_use = false;
+  kmem_cache_free (cache, objs[id]);
+}
@@ -17,6 +17,7 @@ static const struct test tests[] =
     {"alarm-priority", test_alarm_priority},
     {"alarm-zero", test_alarm_zero},
     {"alarm-negative", test_alarm_negative},
+    {"alarm-batch", test_alarm_batch},
     {"priority-change", test_priority_change},
     {"priority-donate-one", test_priority_donate_one},
     {"priority-donate-multiple", test_priority_donate_multiple},
@@ -29,6 +30,17 @@ static const struct test tests[] =
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"palloc-zero-refill", test_palloc_zero_refill},
+    {"rwlock-upgrade", test_rwlock_upgrade},
+    {"completion-wait", test_completion_wait},
+    {"latch-wait", test_latch_wait},
+    {"barrier-reuse", test_barrier_reuse},
+    {"msgq-block", test_msgq_block},
+    {"workqueue-cancel", test_workqueue_cancel},
+    {"lock-timeout-donate", test_lock_timeout_donate},
+    {"palloc-buddy", test_palloc_buddy},
+    {"slab-cache", test_slab_cache},
+    {"malloc-magazine", test_malloc_magazine},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
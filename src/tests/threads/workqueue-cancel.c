@@ -0,0 +1,95 @@
+/* Submits work items to a private single-worker queue while its
+   worker is stuck on another item, cancels one of them, then
+   lets the worker go and flushes the queue.  The canceled item
+   must not run, and the others must run highest priority first,
+   each exactly once. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+
+#define MAX_RUNS 8
+
+static struct workqueue wq;             /* Its worker outlives the test. */
+static struct semaphore started;        /* Upped when blocker starts. */
+static struct semaphore gate;           /* Blocker waits on this. */
+static const char *runs[MAX_RUNS];      /* Items run, in order. */
+static int run_cnt;
+
+static work_func blocker_func;
+static work_func record_func;
+static void print_runs (void);
+
+void
+test_workqueue_cancel (void) 
+{
+  struct work blocker, low, high, doomed;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&started, 0);
+  sema_init (&gate, 0);
+  run_cnt = 0;
+  workqueue_init (&wq, "test", 1, PRI_DEFAULT);
+
+  work_init (&blocker, blocker_func, "blocker", PRI_DEFAULT);
+  work_init (&low, record_func, "low", PRI_DEFAULT);
+  work_init (&high, record_func, "high", PRI_DEFAULT + 5);
+  work_init (&doomed, record_func, "doomed", PRI_DEFAULT + 3);
+
+  work_submit (&wq, &blocker);
+  sema_down (&started);
+  msg ("Worker is busy.");
+
+  if (!work_submit (&wq, &low) || !work_submit (&wq, &doomed)
+      || !work_submit (&wq, &high))
+    fail ("work_submit() refused an idle item.");
+  if (work_submit (&wq, &doomed))
+    fail ("work_submit() accepted a pending item.");
+  if (!work_cancel (&wq, &doomed))
+    fail ("work_cancel() did not cancel a pending item.");
+  if (work_cancel (&wq, &doomed))
+    fail ("work_cancel() canceled an item twice.");
+  msg ("Canceled one item.");
+
+  sema_up (&gate);
+  workqueue_flush (&wq);
+  print_runs ();
+
+  msg ("Resubmitting an item that has run.");
+  if (!work_submit (&wq, &low))
+    fail ("work_submit() refused an item that has run.");
+  workqueue_flush (&wq);
+  print_runs ();
+}
+
+static void
+blocker_func (void *name) 
+{
+  sema_up (&started);
+  sema_down (&gate);
+  record_func (name);
+}
+
+static void
+record_func (void *name) 
+{
+  ASSERT (run_cnt < MAX_RUNS);
+  runs[run_cnt++] = name;
+}
+
+/* Prints and forgets the items that have run. */
+static void
+print_runs (void) 
+{
+  int i;
+
+  msg ("After flush, %d items have run:", run_cnt);
+  for (i = 0; i < run_cnt; i++)
+    msg ("  %s", runs[i]);
+  run_cnt = 0;
+}
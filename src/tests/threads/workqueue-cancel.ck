@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(workqueue-cancel) begin
+(workqueue-cancel) Worker is busy.
+(workqueue-cancel) Canceled one item.
+(workqueue-cancel) After flush, 3 items have run:
+(workqueue-cancel)   blocker
+(workqueue-cancel)   high
+(workqueue-cancel)   low
+(workqueue-cancel) Resubmitting an item that has run.
+(workqueue-cancel) After flush, 1 items have run:
+(workqueue-cancel)   low
+(workqueue-cancel) end
+EOF
+pass;
@@ -19,7 +19,9 @@
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -86,6 +88,7 @@ main (void)
   /* Initialize memory system. */
   palloc_init ();
   malloc_init ();
+  kmem_init ();
   paging_init ();
 
   /* Segmentation. */
@@ -106,6 +109,9 @@ main (void)
 
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
+  timer_start ();
+  workqueue_start ();
+  palloc_start ();
   serial_init_queue ();
   timer_calibrate ();
 
@@ -244,6 +250,30 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
+      else if (!strcmp (name, "-ts")) 
+        {
+          thread_time_slice = value != NULL ? atoi (value) : 0;
+          if (thread_time_slice <= 0)
+            PANIC ("time slice must be positive");
+        }
+      else if (!strcmp (name, "-adaptive-ts"))
+        thread_adaptive_slice = true;
+      else if (!strcmp (name, "-lockstat"))
+        lock_stats = true;
+      else if (!strcmp (name, "-intr-trace"))
+        intr_trace = true;
+      else if (!strcmp (name, "-palloc")) 
+        {
+          if (value != NULL && !strcmp (value, "buddy"))
+            palloc_buddy = true;
+          else if (value != NULL && !strcmp (value, "bitmap"))
+            palloc_buddy = false;
+          else
+            PANIC ("unknown page allocator `%s' (use -h for help)",
+                   value != NULL ? value : "");
+        }
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -349,6 +379,12 @@ usage (void)
           "  -f                 Format file system disk during startup.\n"
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -tickless          Stop the periodic timer tick while idle.\n"
+          "  -ts=TICKS          Set the time slice to TICKS timer ticks.\n"
+          "  -adaptive-ts       Adapt time slices to I/O- or CPU-bound threads.\n"
+          "  -lockstat          Print lock contention statistics at shutdown.\n"
+          "  -intr-trace        Print the longest interrupts-off sections.\n"
+          "  -palloc=ALLOCATOR  Use page allocator `bitmap' (default) or `buddy'.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -387,6 +423,10 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  palloc_print_stats ();
+  kmem_print_stats ();
+  lock_print_stats ();
+  intr_print_stats ();
 #ifdef FILESYS
   disk_print_stats ();
 #endif
@@ -35,6 +35,32 @@ static const char *intr_names[INTR_CNT];
 static bool in_external_intr;   /* Are we processing an external interrupt? */
 static bool yield_on_return;    /* Should we yield on interrupt return? */
 
+/* If true, trace how long interrupts stay off.
+   Controlled by kernel command-line option "-intr-trace". */
+bool intr_trace;
+
+/* Number of longest interrupts-off sections to keep. */
+#define INTR_TRACE_TOP 10
+
+/* An interrupts-off section. */
+struct intr_section 
+  {
+    uint64_t cycles;            /* Duration, in TSC cycles. */
+    void *disabled_at;          /* Return address into the disabler. */
+    void *enabled_at;           /* Return address into the enabler. */
+  };
+
+/* Longest sections seen so far, in no particular order. */
+static struct intr_section longest[INTR_TRACE_TOP];
+
+/* Start of the current interrupts-off section, if traced.
+   OFF_SINCE is 0 if no traced section is open. */
+static uint64_t off_since;
+static void *off_caller;
+
+static void trace_disable (void *caller);
+static void trace_enable (void *caller);
+
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
 static void pic_end_of_interrupt (int irq);
@@ -67,7 +93,23 @@ intr_get_level (void)
 enum intr_level
 intr_set_level (enum intr_level level) 
 {
-  return level == INTR_ON ? intr_enable () : intr_disable ();
+  enum intr_level old_level = intr_get_level ();
+
+  if (level == INTR_ON) 
+    {
+      ASSERT (!intr_context ());
+      if (intr_trace && old_level == INTR_OFF)
+        trace_enable (__builtin_return_address (0));
+      asm volatile ("sti");
+    }
+  else 
+    {
+      asm volatile ("cli" : : : "memory");
+      if (intr_trace && old_level == INTR_ON)
+        trace_disable (__builtin_return_address (0));
+    }
+
+  return old_level;
 }
 
 /* Enables interrupts and returns the previous interrupt status. */
@@ -77,6 +119,9 @@ intr_enable (void)
   enum intr_level old_level = intr_get_level ();
   ASSERT (!intr_context ());
 
+  if (intr_trace && old_level == INTR_OFF)
+    trace_enable (__builtin_return_address (0));
+
   /* Enable interrupts by setting the interrupt flag.
 
      See [IA32-v2b] "STI" and [IA32-v3a] 5.8.1 "Masking Maskable
@@ -97,9 +142,84 @@ intr_disable (void)
      Hardware Interrupts". */
   asm volatile ("cli" : : : "memory");
 
+  if (intr_trace && old_level == INTR_ON)
+    trace_disable (__builtin_return_address (0));
+
   return old_level;
 }
-
+
+/* Opens an interrupts-off section, disabled by the function that
+   CALLER returns into.  Interrupts must be off. */
+static void
+trace_disable (void *caller) 
+{
+  off_since = rdtsc ();
+  off_caller = caller;
+}
+
+/* Closes the current interrupts-off section, if one is open,
+   enabled by the function that CALLER returns into, and records
+   it if it is among the longest so far.  Interrupts must be
+   off. */
+static void
+trace_enable (void *caller) 
+{
+  struct intr_section *shortest;
+  uint64_t cycles;
+  int i;
+
+  if (off_since == 0)
+    return;
+  cycles = rdtsc () - off_since;
+  off_since = 0;
+
+  shortest = &longest[0];
+  for (i = 1; i < INTR_TRACE_TOP; i++)
+    if (longest[i].cycles < shortest->cycles)
+      shortest = &longest[i];
+  if (cycles > shortest->cycles) 
+    {
+      shortest->cycles = cycles;
+      shortest->disabled_at = off_caller;
+      shortest->enabled_at = caller;
+    }
+}
+
+/* Prints the longest interrupts-off sections, longest first, if
+   tracing is enabled.  The addresses can be passed to the
+   `backtrace' utility to find the functions that disabled and
+   re-enabled interrupts. */
+void
+intr_print_stats (void) 
+{
+  bool printed[INTR_TRACE_TOP];
+  int n, i;
+
+  if (!intr_trace)
+    return;
+
+  for (i = 0; i < INTR_TRACE_TOP; i++)
+    printed[i] = false;
+  for (n = 0; n < INTR_TRACE_TOP; n++) 
+    {
+      int max = -1;
+
+      for (i = 0; i < INTR_TRACE_TOP; i++)
+        if (!printed[i] && longest[i].cycles > 0
+            && (max < 0 || longest[i].cycles > longest[max].cycles))
+          max = i;
+      if (max < 0)
+        break;
+      printed[max] = true;
+
+      printf ("Interrupts off for %"PRIu64" cycles (%"PRId64" us), "
+              "call stack: %p %p\n",
+              longest[max].cycles,
+              timer_cycles_to_ns (longest[max].cycles) / 1000,
+              longest[max].disabled_at, longest[max].enabled_at);
+    }
+}
+
 /* Initializes the interrupt system. */
 void
 intr_init (void)
@@ -353,6 +473,16 @@ intr_handler (struct intr_frame *frame)
 
       in_external_intr = true;
       yield_on_return = false;
+
+      /* Interrupts were on until this interrupt arrived, so any
+         traced section was closed without us seeing it, e.g. by
+         the idle thread's "sti". */
+      off_since = 0;
+
+      /* Bring back the periodic tick if this interrupt woke us
+         from a tickless idle period. */
+      if (frame->vec_no != 0x20)
+        timer_exit_idle ();
     }
 
   /* Invoke the interrupt's handler. */
@@ -383,7 +513,7 @@ intr_handler (struct intr_frame *frame)
       pic_end_of_interrupt (frame->vec_no); 
 
       if (yield_on_return) 
-        thread_yield (); 
+        thread_yield_preempted (); 
     }
 }
 
@@ -15,6 +15,10 @@ enum intr_level intr_get_level (void);
 enum intr_level intr_set_level (enum intr_level);
 enum intr_level intr_enable (void);
 enum intr_level intr_disable (void);
+
+/* If true, trace how long interrupts stay off.
+   Controlled by kernel command-line option "-intr-trace". */
+extern bool intr_trace;
 
 /* Interrupt stack frame. */
 struct intr_frame
@@ -66,5 +70,6 @@ void intr_yield_on_return (void);
 
 void intr_dump_frame (const struct intr_frame *);
 const char *intr_name (uint8_t vec);
+void intr_print_stats (void);
 
 #endif /* threads/interrupt.h */
@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -26,7 +27,19 @@
    When we free a block, we add it to its descriptor's free list.
    But if the arena that the block was in now has no in-use
    blocks, we remove all of the arena's blocks from the free list
-   and give the arena back to the page allocator.
+   and give the arena back to the page allocator.  To avoid
+   taking a page and giving it back on every call when a single
+   block is allocated and freed repeatedly, each descriptor keeps
+   up to EMPTY_ARENAS arenas with no in-use blocks.
+
+   In front of all that, each descriptor has a "magazine", a
+   small stack of recently freed blocks.  free() pushes a block
+   onto the magazine if there is room, and malloc() pops one off
+   if it is not empty.  The magazine is protected by turning off
+   interrupts for a few instructions instead of by the
+   descriptor's lock, so a malloc() and free() pair that hits the
+   magazine never sleeps or touches the arena.  Blocks in the
+   magazine still count as in use in their arenas.
 
    We can't handle blocks bigger than 2 kB using this scheme,
    because they're too big to fit in a single page with a
@@ -34,13 +47,25 @@
    with the page allocator and sticking the allocation size at
    the beginning of the allocated block's arena header. */
 
+/* Number of blocks in a descriptor's magazine. */
+#define MAGAZINE_SIZE 8
+
+/* Number of arenas with no in-use blocks a descriptor keeps. */
+#define EMPTY_ARENAS 1
+
 /* Descriptor. */
 struct desc
   {
     size_t block_size;          /* Size of each element in bytes. */
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
     struct list free_list;      /* List of free blocks. */
+    size_t empty_cnt;           /* Arenas with no in-use blocks. */
     struct lock lock;           /* Lock. */
+
+    /* Recently freed blocks.  Protected by disabling
+       interrupts, not by LOCK. */
+    struct block *magazine[MAGAZINE_SIZE];
+    size_t magazine_cnt;        /* Number of blocks in MAGAZINE. */
   };
 
 /* Magic number for detecting arena corruption. */
@@ -66,6 +91,8 @@ static size_t desc_cnt;         /* Number of descriptors. */
 
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static struct block *magazine_get (struct desc *);
+static bool magazine_put (struct desc *, struct block *);
 
 /* Initializes the malloc() descriptors. */
 void
@@ -80,7 +107,9 @@ malloc_init (void)
       d->block_size = block_size;
       d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
       list_init (&d->free_list);
-      lock_init (&d->lock);
+      d->empty_cnt = 0;
+      lock_init_named (&d->lock, "malloc");
+      d->magazine_cnt = 0;
     }
 }
 
@@ -93,6 +122,8 @@ malloc (size_t size)
   struct block *b;
   struct arena *a;
 
+  ASSERT (!intr_context ());
+
   /* A null pointer satisfies a request for 0 bytes. */
   if (size == 0)
     return NULL;
@@ -119,6 +150,11 @@ malloc (size_t size)
       return a + 1;
     }
 
+  /* Try the magazine first. */
+  b = magazine_get (d);
+  if (b != NULL)
+    return b;
+
   lock_acquire (&d->lock);
 
   /* If the free list is empty, create a new arena. */
@@ -138,6 +174,7 @@ malloc (size_t size)
       a->magic = ARENA_MAGIC;
       a->desc = d;
       a->free_cnt = d->blocks_per_arena;
+      d->empty_cnt++;
       for (i = 0; i < d->blocks_per_arena; i++) 
         {
           struct block *b = arena_to_block (a, i);
@@ -148,7 +185,8 @@ malloc (size_t size)
   /* Get a block from free list and return it. */
   b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
   a = block_to_arena (b);
-  a->free_cnt--;
+  if (a->free_cnt-- == d->blocks_per_arena)
+    d->empty_cnt--;
   lock_release (&d->lock);
   return b;
 }
@@ -218,6 +256,8 @@ realloc (void *old_block, size_t new_size)
 void
 free (void *p) 
 {
+  ASSERT (!intr_context ());
+
   if (p != NULL)
     {
       struct block *b = p;
@@ -232,24 +272,34 @@ free (void *p)
           /* Clear the block to help detect use-after-free bugs. */
           memset (b, 0xcc, d->block_size);
 #endif
+
+          /* Keep the block in the magazine if there is room. */
+          if (magazine_put (d, b))
+            return;
   
           lock_acquire (&d->lock);
 
           /* Add block to free list. */
           list_push_front (&d->free_list, &b->free_elem);
 
-          /* If the arena is now entirely unused, free it. */
+          /* If the arena is now entirely unused, free it, unless
+             we are short of empty arenas. */
           if (++a->free_cnt >= d->blocks_per_arena) 
             {
-              size_t i;
-
               ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++) 
+              if (d->empty_cnt < EMPTY_ARENAS)
+                d->empty_cnt++;
+              else
                 {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
+                  size_t i;
+
+                  for (i = 0; i < d->blocks_per_arena; i++) 
+                    {
+                      struct block *b = arena_to_block (a, i);
+                      list_remove (&b->free_elem);
+                    }
+                  palloc_free_page (a);
                 }
-              palloc_free_page (a);
             }
 
           lock_release (&d->lock);
@@ -292,3 +342,38 @@ arena_to_block (struct arena *a, size_t idx)
                            + sizeof *a
                            + idx * a->desc->block_size);
 }
+
+/* Pops and returns a block from D's magazine, or returns a null
+   pointer if the magazine is empty. */
+static struct block *
+magazine_get (struct desc *d) 
+{
+  struct block *b = NULL;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (d->magazine_cnt > 0)
+    b = d->magazine[--d->magazine_cnt];
+  intr_set_level (old_level);
+
+  return b;
+}
+
+/* Pushes block B onto D's magazine and returns true, or returns
+   false if the magazine is full. */
+static bool
+magazine_put (struct desc *d, struct block *b) 
+{
+  bool success = false;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (d->magazine_cnt < MAGAZINE_SIZE) 
+    {
+      d->magazine[d->magazine_cnt++] = b;
+      success = true;
+    }
+  intr_set_level (old_level);
+
+  return success;
+}
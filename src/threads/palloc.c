@@ -2,14 +2,17 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -24,7 +27,32 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool keeps track of its free pages in one of two ways,
+   chosen at boot with the "-palloc" option.  By default, a
+   bitmap has one bit per page, and allocation scans it for a run
+   of free pages.  With "-palloc=buddy", a binary buddy allocator
+   keeps free blocks of 2**ORDER pages on per-order free lists, so
+   that allocation and freeing take time logarithmic in the pool
+   size and freed blocks coalesce with their buddies.
+
+   A low-priority "pagezero" thread keeps a small reserve of
+   zeroed pages in each pool, so that single-page PAL_ZERO
+   requests usually need not clear a page themselves. */
+
+/* Number of zeroed pages to keep in reserve in each pool, and the
+   number left when the zeroing thread is woken to refill it. */
+#define ZERO_RESERVE 16
+#define ZERO_LOW (ZERO_RESERVE / 2)
+
+/* Number of buddy block orders, so that the largest block is
+   2**(BUDDY_ORDERS - 1) pages, or 1 GB. */
+#define BUDDY_ORDERS 19
+
+/* Flag in a pool's order map for the first page of a free
+   block.  The low bits give the block's order. */
+#define BUDDY_FREE 0x80
 
 /* A memory pool. */
 struct pool
@@ -32,8 +60,29 @@ struct pool
     struct lock lock;                   /* Mutual exclusion. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
     uint8_t *base;                      /* Base of pool. */
+    size_t page_cnt;                    /* Number of pages in pool. */
+    size_t free_cnt;                    /* Free pages, including zeroed. */
+    size_t next_fit;                    /* Where to start bitmap scans. */
+    void *zeroed[ZERO_RESERVE];         /* Reserve of zeroed pages. */
+    size_t zeroed_cnt;                  /* Number of pages in ZEROED. */
+
+    /* Buddy allocator only. */
+    uint8_t *orders;                    /* Order map, one byte per page. */
+    struct list free_lists[BUDDY_ORDERS]; /* Free blocks by order. */
   };
 
+/* If true, use the buddy allocator instead of the bitmap.
+   Controlled by kernel command-line option "-palloc". */
+bool palloc_buddy;
+
+/* Up'd to have the zeroing thread refill the pools' reserves.
+   ZERO_PENDING is true from then until the thread starts its next
+   round of refilling, so that it is woken only once however many
+   times a reserve runs low in between.  Both are accessed with
+   interrupts off, since the two pools have separate locks. */
+static struct semaphore zero_sema;
+static bool zero_pending;
+
 /* Two pools: one for kernel data, one for user pages. */
 struct pool kernel_pool, user_pool;
 
@@ -43,6 +92,15 @@ size_t user_page_limit = SIZE_MAX;
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static size_t alloc_pages (struct pool *, size_t page_cnt);
+static void free_pages (struct pool *, size_t page_idx, size_t page_cnt);
+static void drain_zeroed (struct pool *);
+static void wake_zeroer (struct pool *);
+static void zero_pages (void *aux);
+static void refill_zeroed (struct pool *);
+static size_t bitmap_alloc (struct pool *, size_t page_cnt);
+static size_t buddy_alloc (struct pool *, size_t page_cnt);
+static void buddy_free (struct pool *, size_t page_idx, size_t page_cnt);
 
 /* Initializes the page allocator. */
 void
@@ -66,6 +124,16 @@ palloc_init (void)
   init_pool (&kernel_pool, free_start, kernel_pages, "kernel pool");
   init_pool (&user_pool, free_start + kernel_pages * PGSIZE,
              user_pages, "user pool");
+  sema_init (&zero_sema, 1);
+  zero_pending = true;
+}
+
+/* Starts the thread that keeps the pools' reserves of zeroed
+   pages filled.  Must be called after thread_start(). */
+void
+palloc_start (void) 
+{
+  thread_create ("pagezero", PRI_MIN, zero_pages, NULL);
 }
 
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
@@ -78,24 +146,43 @@ void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
-  void *pages;
-  size_t page_idx;
+  void *pages = NULL;
+  bool zeroed = false;
 
   if (page_cnt == 0)
     return NULL;
 
   lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  if (page_cnt == 1 && pool->zeroed_cnt > 0
+      && (flags & PAL_ZERO || pool->free_cnt == pool->zeroed_cnt)) 
+    {
+      /* Take a page from the reserve, if it is a zeroed page
+         that we want or if the reserve is all that is left. */
+      pages = pool->zeroed[--pool->zeroed_cnt];
+      pool->free_cnt--;
+      zeroed = true;
+      wake_zeroer (pool);
+    }
+  else if (pool->free_cnt >= page_cnt) 
+    {
+      size_t page_idx;
 
-  if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
-  else
-    pages = NULL;
+      /* Put the reserve back if the request might need it. */
+      if (pool->free_cnt - pool->zeroed_cnt < page_cnt)
+        drain_zeroed (pool);
+      page_idx = alloc_pages (pool, page_cnt);
+      if (page_idx != BITMAP_ERROR) 
+        {
+          pages = pool->base + PGSIZE * page_idx;
+          pool->free_cnt -= page_cnt;
+        }
+      wake_zeroer (pool);
+    }
+  lock_release (&pool->lock);
 
   if (pages != NULL) 
     {
-      if (flags & PAL_ZERO)
+      if (flags & PAL_ZERO && !zeroed)
         memset (pages, 0, PGSIZE * page_cnt);
     }
   else 
@@ -144,8 +231,11 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
-  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  lock_acquire (&pool->lock);
+  free_pages (pool, page_idx, page_cnt);
+  pool->free_cnt += page_cnt;
+  wake_zeroer (pool);
+  lock_release (&pool->lock);
 }
 
 /* Frees the page at PAGE. */
@@ -155,25 +245,85 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Stores the number of free pages and the number of pages in use
+   in the user pool, if PAL_USER is set in FLAGS, or otherwise the
+   kernel pool, into *FREE_CNT and *USED_CNT.  The counts may be
+   stale by the time the caller examines them. */
+void
+palloc_get_stats (enum palloc_flags flags, size_t *free_cnt,
+                  size_t *used_cnt) 
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+
+  lock_acquire (&pool->lock);
+  *free_cnt = pool->free_cnt;
+  *used_cnt = pool->page_cnt - pool->free_cnt;
+  lock_release (&pool->lock);
+}
+
+/* Returns the number of pages in the zeroed reserve of the user
+   pool, if PAL_USER is set in FLAGS, or otherwise the kernel
+   pool.  The count may be stale by the time the caller examines
+   it. */
+size_t
+palloc_zeroed_cnt (enum palloc_flags flags) 
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+
+  return pool->zeroed_cnt;
+}
+
+/* Prints page allocator statistics.  Called from power_off(),
+   possibly on the way out of a kernel panic, so it reads the
+   counters without taking the pool locks. */
+void
+palloc_print_stats (void) 
+{
+  printf ("Kernel pool: %zu pages free (%zu zeroed), %zu in use\n",
+          kernel_pool.free_cnt, kernel_pool.zeroed_cnt,
+          kernel_pool.page_cnt - kernel_pool.free_cnt);
+  printf ("User pool: %zu pages free (%zu zeroed), %zu in use\n",
+          user_pool.free_cnt, user_pool.zeroed_cnt,
+          user_pool.page_cnt - user_pool.free_cnt);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
-  if (bm_pages > page_cnt)
-    PANIC ("Not enough memory in %s for bitmap.", name);
-  page_cnt -= bm_pages;
+  /* We'll put the pool's used_map, or its order map, at its
+     base.  Calculate the space needed for it and subtract it
+     from the pool's size. */
+  size_t map_size = palloc_buddy ? page_cnt : bitmap_buf_size (page_cnt);
+  size_t map_pages = DIV_ROUND_UP (map_size, PGSIZE);
+  if (map_pages > page_cnt)
+    PANIC ("Not enough memory in %s for %s.", name,
+           palloc_buddy ? "order map" : "bitmap");
+  page_cnt -= map_pages;
 
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
   /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
-  p->base = base + bm_pages * PGSIZE;
+  lock_init_named (&p->lock, name);
+  p->base = base + map_pages * PGSIZE;
+  p->page_cnt = page_cnt;
+  p->free_cnt = page_cnt;
+  p->next_fit = 0;
+  p->zeroed_cnt = 0;
+  if (palloc_buddy) 
+    {
+      int order;
+
+      p->used_map = NULL;
+      p->orders = base;
+      memset (p->orders, 0, page_cnt);
+      for (order = 0; order < BUDDY_ORDERS; order++)
+        list_init (&p->free_lists[order]);
+      buddy_free (p, 0, page_cnt);
+    }
+  else
+    p->used_map = bitmap_create_in_buf (page_cnt, base, map_pages * PGSIZE);
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -183,7 +333,250 @@ page_from_pool (const struct pool *pool, void *page)
 {
   size_t page_no = pg_no (page);
   size_t start_page = pg_no (pool->base);
-  size_t end_page = start_page + bitmap_size (pool->used_map);
+  size_t end_page = start_page + pool->page_cnt;
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Allocates PAGE_CNT contiguous pages from POOL's bitmap or
+   buddy free lists and returns the index of the first one, or
+   BITMAP_ERROR if there is no long enough run of free pages.
+   Does not use or update POOL's zeroed reserve or free count. */
+static size_t
+alloc_pages (struct pool *pool, size_t page_cnt) 
+{
+  return palloc_buddy ? buddy_alloc (pool, page_cnt)
+                      : bitmap_alloc (pool, page_cnt);
+}
+
+/* Frees the PAGE_CNT pages starting at PAGE_IDX to POOL's bitmap
+   or buddy free lists.  Does not update POOL's free count. */
+static void
+free_pages (struct pool *pool, size_t page_idx, size_t page_cnt) 
+{
+  if (palloc_buddy)
+    buddy_free (pool, page_idx, page_cnt);
+  else 
+    {
+      ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+      bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+    }
+}
+
+/* Frees all of the pages in POOL's zeroed reserve back to its
+   bitmap or buddy free lists.  They remain counted as free. */
+static void
+drain_zeroed (struct pool *pool) 
+{
+  ASSERT (lock_held_by_current_thread (&pool->lock));
+
+  while (pool->zeroed_cnt > 0) 
+    {
+      void *page = pool->zeroed[--pool->zeroed_cnt];
+      free_pages (pool, pg_no (page) - pg_no (pool->base), 1);
+    }
+}
+
+/* Wakes the zeroing thread if POOL's zeroed reserve is down to
+   ZERO_LOW pages or fewer, there are enough free pages to refill
+   it, and the thread has not already been woken.  POOL's lock
+   must be held. */
+static void
+wake_zeroer (struct pool *pool) 
+{
+  enum intr_level old_level;
+
+  ASSERT (lock_held_by_current_thread (&pool->lock));
+
+  if (pool->zeroed_cnt > ZERO_LOW
+      || pool->free_cnt - pool->zeroed_cnt <= ZERO_RESERVE)
+    return;
+
+  old_level = intr_disable ();
+  if (!zero_pending) 
+    {
+      zero_pending = true;
+      sema_up (&zero_sema);
+    }
+  intr_set_level (old_level);
+}
+
+/* Zeroing thread.  Refills both pools' zeroed reserves whenever
+   one runs low.  The MLFQS ignores the PRI_MIN given to this
+   thread at creation, so there it makes itself as nice as
+   possible instead. */
+static void
+zero_pages (void *aux UNUSED) 
+{
+  if (thread_mlfqs)
+    thread_set_nice (NICE_MAX);
+
+  for (;;) 
+    {
+      sema_down (&zero_sema);
+      zero_pending = false;
+      refill_zeroed (&kernel_pool);
+      refill_zeroed (&user_pool);
+    }
+}
+
+/* Fills POOL's zeroed reserve, clearing each page without holding
+   POOL's lock.  Stops early rather than take the last
+   ZERO_RESERVE pages that are not already in the reserve. */
+static void
+refill_zeroed (struct pool *pool) 
+{
+  for (;;) 
+    {
+      size_t page_idx = BITMAP_ERROR;
+      void *page;
+
+      lock_acquire (&pool->lock);
+      if (pool->zeroed_cnt < ZERO_RESERVE
+          && pool->free_cnt - pool->zeroed_cnt > ZERO_RESERVE)
+        page_idx = alloc_pages (pool, 1);
+      if (page_idx != BITMAP_ERROR)
+        pool->free_cnt--;
+      lock_release (&pool->lock);
+      if (page_idx == BITMAP_ERROR)
+        break;
+
+      page = pool->base + PGSIZE * page_idx;
+      memset (page, 0, PGSIZE);
+
+      /* Only this thread adds to the reserve, so there is still
+         room. */
+      lock_acquire (&pool->lock);
+      ASSERT (pool->zeroed_cnt < ZERO_RESERVE);
+      pool->zeroed[pool->zeroed_cnt++] = page;
+      pool->free_cnt++;
+      lock_release (&pool->lock);
+    }
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL's bitmap and
+   returns the index of the first one, or BITMAP_ERROR if there
+   is no long enough run of free pages.  Searches onward from
+   where the last allocation ended, to skip over the pages that
+   are usually still in use at the start of the pool, and then
+   from the start. */
+static size_t
+bitmap_alloc (struct pool *pool, size_t page_cnt) 
+{
+  size_t page_idx;
+
+  ASSERT (lock_held_by_current_thread (&pool->lock));
+
+  page_idx = bitmap_scan_and_flip (pool->used_map, pool->next_fit,
+                                   page_cnt, false);
+  if (page_idx == BITMAP_ERROR && pool->next_fit != 0)
+    page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+  if (page_idx != BITMAP_ERROR)
+    pool->next_fit = (page_idx + page_cnt) % pool->page_cnt;
+  return page_idx;
+}
+
+/* Returns the list element stored in free block PAGE_IDX of
+   POOL. */
+static struct list_elem *
+buddy_elem (struct pool *pool, size_t page_idx) 
+{
+  return (struct list_elem *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Returns the index of the first page of the free block whose
+   list element is ELEM in POOL. */
+static size_t
+buddy_index (struct pool *pool, struct list_elem *elem) 
+{
+  return ((uint8_t *) elem - pool->base) / PGSIZE;
+}
+
+/* Adds the free block of 2**ORDER pages starting at PAGE_IDX to
+   POOL's free lists. */
+static void
+buddy_push (struct pool *pool, size_t page_idx, int order) 
+{
+  pool->orders[page_idx] = BUDDY_FREE | order;
+  list_push_front (&pool->free_lists[order], buddy_elem (pool, page_idx));
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL's buddy free
+   lists and returns the index of the first one, or BITMAP_ERROR
+   if there is no large enough block.  Takes the smallest block
+   of 2**ORDER pages that is large enough, splitting a larger one
+   if necessary, and gives back any pages beyond PAGE_CNT. */
+static size_t
+buddy_alloc (struct pool *pool, size_t page_cnt) 
+{
+  int order, split;
+  size_t page_idx;
+
+  ASSERT (lock_held_by_current_thread (&pool->lock));
+
+  for (order = 0; order < BUDDY_ORDERS; order++)
+    if ((size_t) 1 << order >= page_cnt)
+      break;
+  for (split = order; split < BUDDY_ORDERS; split++)
+    if (!list_empty (&pool->free_lists[split]))
+      break;
+  if (split >= BUDDY_ORDERS)
+    return BITMAP_ERROR;
+
+  page_idx = buddy_index (pool, list_pop_front (&pool->free_lists[split]));
+  pool->orders[page_idx] = 0;
+
+  /* Split off and free upper halves until the block is the
+     right size. */
+  while (split > order) 
+    {
+      split--;
+      buddy_push (pool, page_idx + ((size_t) 1 << split), split);
+    }
+
+  /* Give back the pages past PAGE_CNT. */
+  if (page_cnt < (size_t) 1 << order)
+    buddy_free (pool, page_idx + page_cnt, ((size_t) 1 << order) - page_cnt);
+
+  return page_idx;
+}
+
+/* Frees the PAGE_CNT pages starting at PAGE_IDX in POOL to the
+   buddy free lists, as the largest naturally aligned blocks that
+   they can be divided into, and coalesces each block with its
+   buddy as long as the buddy is free too. */
+static void
+buddy_free (struct pool *pool, size_t page_idx, size_t page_cnt) 
+{
+  while (page_cnt > 0) 
+    {
+      size_t idx = page_idx;
+      int order = 0;
+
+      /* Find the largest aligned block at PAGE_IDX. */
+      while (order + 1 < BUDDY_ORDERS
+             && (page_idx & (((size_t) 1 << (order + 1)) - 1)) == 0
+             && (size_t) 1 << (order + 1) <= page_cnt)
+        order++;
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+
+      ASSERT (!(pool->orders[idx] & BUDDY_FREE));
+
+      /* Merge with free buddies. */
+      while (order + 1 < BUDDY_ORDERS) 
+        {
+          size_t buddy = idx ^ ((size_t) 1 << order);
+
+          if (buddy + ((size_t) 1 << order) > pool->page_cnt
+              || pool->orders[buddy] != (BUDDY_FREE | order))
+            break;
+          list_remove (buddy_elem (pool, buddy));
+          pool->orders[buddy] = 0;
+          if (buddy < idx)
+            idx = buddy;
+          order++;
+        }
+      buddy_push (pool, idx, order);
+    }
+}
@@ -1,6 +1,7 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
 /* How to allocate pages. */
@@ -14,10 +15,18 @@ enum palloc_flags
 /* Maximum number of pages to put in user pool. */
 extern size_t user_page_limit;
 
+/* If true, use the buddy allocator instead of the bitmap.
+   Controlled by kernel command-line option "-palloc". */
+extern bool palloc_buddy;
+
 void palloc_init (void);
+void palloc_start (void);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+void palloc_get_stats (enum palloc_flags, size_t *free_cnt, size_t *used_cnt);
+size_t palloc_zeroed_cnt (enum palloc_flags);
+void palloc_print_stats (void);
 
 #endif /* threads/palloc.h */
@@ -0,0 +1,339 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* An object cache, or "slab allocator".
+
+   malloc() rounds every request up to a power of 2, so an
+   object just over a power of 2 in size wastes nearly half of
+   its block.  An object cache instead hands out objects of a
+   single fixed size, packed into pages called "slabs".
+
+   Each slab is one page.  It starts with a header, followed by
+   an array of free-list links, one per object, followed by the
+   objects themselves.  Keeping the links outside the objects
+   means that a free object keeps whatever state its constructor
+   gave it, so the constructor runs only when a slab is created,
+   not on every allocation.
+
+   A cache keeps its slabs on three lists, according to whether
+   they are full, partially used, or empty.  Allocation prefers
+   partially used slabs, so that objects stay packed together.
+   A few empty slabs are kept around so that a cache that
+   repeatedly allocates and frees one object does not take a
+   page from the page allocator and give it back each time. */
+
+/* Maximum number of empty slabs a cache keeps. */
+#define EMPTY_SLABS 1
+
+/* Object cache. */
+struct kmem_cache
+  {
+    struct list_elem elem;      /* Element in all_caches. */
+    const char *name;           /* Name, for statistics. */
+    size_t size;                /* Object size, rounded up to ALIGN. */
+    size_t align;               /* Object alignment. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    size_t obj_ofs;             /* Offset of first object in a slab. */
+    kmem_ctor *ctor;            /* Constructor, or null. */
+    struct list full;           /* Slabs with no free objects. */
+    struct list partial;        /* Slabs with some free objects. */
+    struct list empty;          /* Slabs with no objects in use. */
+    size_t empty_cnt;           /* Number of slabs in EMPTY. */
+    struct lock lock;           /* Protects all of the above. */
+
+    /* Statistics. */
+    size_t slab_cnt;            /* Slabs currently allocated. */
+    size_t in_use;              /* Objects currently allocated. */
+    size_t max_in_use;          /* Maximum of IN_USE. */
+    unsigned allocs;            /* Calls to kmem_cache_alloc(). */
+    unsigned frees;             /* Calls to kmem_cache_free(). */
+    unsigned ctor_calls;        /* Calls to CTOR. */
+  };
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Marks the end of a slab's free list. */
+#define SLAB_END UINT16_MAX
+
+/* Slab header, at the start of each slab's page. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in one of CACHE's lists. */
+    size_t in_use;              /* Number of objects allocated. */
+    uint16_t free;              /* Index of first free object. */
+    uint16_t next[];            /* Next free object, per object. */
+  };
+
+/* All object caches, for kmem_print_stats(). */
+static struct list all_caches;
+
+static struct slab *slab_create (struct kmem_cache *);
+static void slab_destroy (struct kmem_cache *, struct slab *);
+static void *slab_to_obj (struct kmem_cache *, struct slab *, size_t idx);
+static struct slab *obj_to_slab (struct kmem_cache *, void *, size_t *idx);
+
+/* Initializes the object cache allocator. */
+void
+kmem_init (void) 
+{
+  list_init (&all_caches);
+}
+
+/* Creates and returns a cache of objects of SIZE bytes, each
+   aligned on an ALIGN-byte boundary.  ALIGN must be a power of
+   2, or 0 to use pointer alignment.  If CTOR is nonnull, it is
+   called on each object before the object is first allocated.
+   NAME is used only for statistics.
+
+   Must be called after kmem_init().  Panics if memory is not
+   available, because caches are created only during
+   initialization. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, size_t align,
+                   kmem_ctor *ctor) 
+{
+  struct kmem_cache *c;
+  size_t n;
+
+  if (align == 0)
+    align = sizeof (void *);
+  ASSERT ((align & (align - 1)) == 0);
+  ASSERT (size > 0);
+
+  c = malloc (sizeof *c);
+  if (c == NULL)
+    PANIC ("out of memory creating object cache %s", name);
+
+  c->name = name;
+  c->size = ROUND_UP (size, align);
+  c->align = align;
+  c->ctor = ctor;
+
+  /* Fit as many objects as we can into a page, along with the
+     header and a free-list link for each object. */
+  for (n = (PGSIZE - sizeof (struct slab)) / (c->size + sizeof (uint16_t));
+       n > 0; n--) 
+    {
+      c->obj_ofs = ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t),
+                             align);
+      if (c->obj_ofs + n * c->size <= PGSIZE)
+        break;
+    }
+  if (n == 0)
+    PANIC ("%zu-byte objects in cache %s do not fit in a slab",
+           size, name);
+  c->objs_per_slab = n;
+
+  list_init (&c->full);
+  list_init (&c->partial);
+  list_init (&c->empty);
+  c->empty_cnt = 0;
+  lock_init_named (&c->lock, name);
+
+  c->slab_cnt = 0;
+  c->in_use = c->max_in_use = 0;
+  c->allocs = c->frees = c->ctor_calls = 0;
+
+  list_push_back (&all_caches, &c->elem);
+  return c;
+}
+
+/* Allocates and returns an object from cache C.
+   Returns a null pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c) 
+{
+  struct slab *s;
+  size_t idx;
+
+  lock_acquire (&c->lock);
+
+  /* Find a slab with a free object, creating one if need be. */
+  if (!list_empty (&c->partial))
+    s = list_entry (list_front (&c->partial), struct slab, elem);
+  else if (!list_empty (&c->empty)) 
+    {
+      s = list_entry (list_pop_front (&c->empty), struct slab, elem);
+      c->empty_cnt--;
+      list_push_front (&c->partial, &s->elem);
+    }
+  else 
+    {
+      s = slab_create (c);
+      if (s == NULL) 
+        {
+          lock_release (&c->lock);
+          return NULL;
+        }
+      list_push_front (&c->partial, &s->elem);
+    }
+
+  /* Take the first object off its free list. */
+  idx = s->free;
+  ASSERT (idx < c->objs_per_slab);
+  s->free = s->next[idx];
+  if (++s->in_use == c->objs_per_slab) 
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->full, &s->elem);
+    }
+
+  c->allocs++;
+  if (++c->in_use > c->max_in_use)
+    c->max_in_use = c->in_use;
+  lock_release (&c->lock);
+
+  return slab_to_obj (c, s, idx);
+}
+
+/* Frees OBJ, which must have been allocated from cache C with
+   kmem_cache_alloc().  If C has a constructor, OBJ must be in
+   its constructed state. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj) 
+{
+  struct slab *s;
+  size_t idx;
+
+  if (obj == NULL)
+    return;
+
+  s = obj_to_slab (c, obj, &idx);
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs, unless
+     that would destroy its constructed state. */
+  if (c->ctor == NULL)
+    memset (obj, 0xcc, c->size);
+#endif
+
+  lock_acquire (&c->lock);
+
+  /* Put the object back on its slab's free list. */
+  s->next[idx] = s->free;
+  s->free = idx;
+  if (s->in_use == c->objs_per_slab) 
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->partial, &s->elem);
+    }
+  s->in_use--;
+
+  /* Keep an empty slab, unless we already have enough of them. */
+  if (s->in_use == 0) 
+    {
+      list_remove (&s->elem);
+      if (c->empty_cnt < EMPTY_SLABS) 
+        {
+          list_push_front (&c->empty, &s->elem);
+          c->empty_cnt++;
+        }
+      else
+        slab_destroy (c, s);
+    }
+
+  c->frees++;
+  c->in_use--;
+  lock_release (&c->lock);
+}
+
+/* Prints statistics for each object cache. */
+void
+kmem_print_stats (void) 
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&all_caches); e != list_end (&all_caches);
+       e = list_next (e)) 
+    {
+      struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+      printf ("Cache %s: %zu-byte objects, %zu per slab, %zu slabs, "
+              "%zu in use (max %zu), %u allocs, %u frees, %u ctor calls\n",
+              c->name, c->size, c->objs_per_slab, c->slab_cnt,
+              c->in_use, c->max_in_use, c->allocs, c->frees, c->ctor_calls);
+    }
+}
+
+/* Allocates a new slab for cache C and constructs its objects.
+   Returns a null pointer if memory is not available.  C's lock
+   must be held. */
+static struct slab *
+slab_create (struct kmem_cache *c) 
+{
+  struct slab *s;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&c->lock));
+
+  s = palloc_get_page (0);
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->in_use = 0;
+  s->free = 0;
+  for (i = 0; i < c->objs_per_slab; i++) 
+    {
+      s->next[i] = i + 1 < c->objs_per_slab ? i + 1 : SLAB_END;
+      if (c->ctor != NULL)
+        c->ctor (slab_to_obj (c, s, i));
+    }
+  if (c->ctor != NULL)
+    c->ctor_calls += c->objs_per_slab;
+  c->slab_cnt++;
+  return s;
+}
+
+/* Returns slab S, which has no objects in use, to the page
+   allocator.  C's lock must be held. */
+static void
+slab_destroy (struct kmem_cache *c, struct slab *s) 
+{
+  ASSERT (lock_held_by_current_thread (&c->lock));
+  ASSERT (s->in_use == 0);
+
+  s->magic = 0;
+  palloc_free_page (s);
+  c->slab_cnt--;
+}
+
+/* Returns the IDX'th object in slab S of cache C. */
+static void *
+slab_to_obj (struct kmem_cache *c, struct slab *s, size_t idx) 
+{
+  ASSERT (idx < c->objs_per_slab);
+  return (uint8_t *) s + c->obj_ofs + idx * c->size;
+}
+
+/* Returns the slab that OBJ, an object of cache C, is inside,
+   and stores OBJ's index within the slab in *IDX. */
+static struct slab *
+obj_to_slab (struct kmem_cache *c, void *obj, size_t *idx) 
+{
+  struct slab *s = pg_round_down (obj);
+
+  /* Check that the slab is valid and belongs to C. */
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+
+  /* Check that OBJ is properly aligned for the slab. */
+  ASSERT (pg_ofs (obj) >= c->obj_ofs);
+  ASSERT ((pg_ofs (obj) - c->obj_ofs) % c->size == 0);
+
+  *idx = (pg_ofs (obj) - c->obj_ofs) / c->size;
+  ASSERT (*idx < c->objs_per_slab);
+  return s;
+}
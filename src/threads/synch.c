@@ -31,6 +31,50 @@
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Statistics shared by all the locks initialized with the same
+   name by lock_init_named().  Collected only if lock_stats is
+   true.  Times are in nanoseconds, as returned by timer_ns(). */
+struct lock_class 
+  {
+    const char *name;           /* Name given to lock_init_named(). */
+    unsigned acquisitions;      /* Number of times acquired. */
+    unsigned contended;         /* Times a thread had to wait. */
+    int64_t wait_time;          /* Total time spent waiting, in ns. */
+    int64_t max_wait;           /* Longest wait, in ns. */
+    int64_t max_hold;           /* Longest time held, in ns. */
+  };
+
+/* If true, collect statistics for named locks.
+   Controlled by kernel command-line option "-lockstat". */
+bool lock_stats;
+
+/* Lock classes.  Once all are in use, locks with new names go
+   unrecorded. */
+#define LOCK_CLASS_CNT 32
+static struct lock_class lock_classes[LOCK_CLASS_CNT];
+static int lock_class_cnt;
+
+/* Number of lock classes printed by lock_print_stats(). */
+#define LOCK_STATS_TOP 10
+
+/* Timeout that means "wait indefinitely". */
+#define WAIT_FOREVER (-1)
+
+static void lock_acquired (struct lock *, bool contended, int64_t start);
+static bool sema_down_wait (struct semaphore *, int64_t ticks);
+static bool lock_acquire_wait (struct lock *, int64_t ticks);
+static bool cond_wait_wait (struct condition *, struct lock *,
+                            int64_t ticks);
+static void timeout_start (struct thread *, int64_t ticks);
+static bool timeout_expired (struct thread *, int64_t ticks);
+static void timeout (void *thread);
+
+static bool thread_more_priority (const struct list_elem *,
+                                  const struct list_elem *, void *aux);
+static bool waiter_more_priority (const struct list_elem *,
+                                  const struct list_elem *, void *aux);
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -56,24 +100,64 @@ sema_init (struct semaphore *sema, unsigned value)
    This function may sleep, so it must not be called within an
    interrupt handler.  This function may be called with
    interrupts disabled, but if it sleeps then the next scheduled
-   thread will probably turn interrupts back on. This is
-   sema_down function. */
+   thread will probably turn interrupts back on.
+
+   Waiters are kept in priority order, with threads of equal
+   priority in FIFO order, so that sema_up() can wake the
+   highest-priority waiter without searching. */
 void
 sema_down (struct semaphore *sema) 
 {
+  sema_down_wait (sema, WAIT_FOREVER);
+}
+
+/* Like sema_down(), but gives up if SEMA's value stays zero for
+   TICKS timer ticks.  Returns true if SEMA was decremented, false
+   if the wait timed out.  If TICKS is zero or negative, does not
+   wait at all, like sema_try_down().
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+bool
+sema_down_timeout (struct semaphore *sema, int64_t ticks) 
+{
+  if (ticks <= 0)
+    return sema_try_down (sema);
+  return sema_down_wait (sema, ticks);
+}
+
+/* Waits for SEMA's value to become positive and then decrements
+   it, giving up after TICKS timer ticks unless TICKS is
+   WAIT_FOREVER.  Returns true if SEMA was decremented, false if
+   the wait timed out. */
+static bool
+sema_down_wait (struct semaphore *sema, int64_t ticks) 
+{
+  struct thread *curr = thread_current ();
   enum intr_level old_level;
+  bool success;
 
   ASSERT (sema != NULL);
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
-  while (sema->value == 0) 
+  if (sema->value == 0 && ticks != WAIT_FOREVER)
+    timeout_start (curr, ticks);
+  while (sema->value == 0 && !timeout_expired (curr, ticks)) 
     {
-      list_push_back (&sema->waiters, &thread_current ()->elem);
+      list_insert_ordered (&sema->waiters, &curr->elem,
+                           thread_more_priority, NULL);
+      curr->waiting_sema = sema;
       thread_block ();
     }
-  sema->value--;
+  success = sema->value > 0;
+  if (success)
+    sema->value--;
+  if (ticks != WAIT_FOREVER)
+    timer_cancel (&curr->sleep_callout);
   intr_set_level (old_level);
+
+  return success;
 }
 
 /* Down or "P" operation on a semaphore, but only if the
@@ -103,7 +187,9 @@ sema_try_down (struct semaphore *sema)
 }
 
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
-   and wakes up one thread of those waiting for SEMA, if any.
+   and wakes up the highest-priority thread of those waiting for
+   SEMA, if any, yielding to it if it outranks the running
+   thread.
 
    This function may be called from an interrupt handler. */
 void
@@ -115,9 +201,14 @@ sema_up (struct semaphore *sema)
 
   old_level = intr_disable ();
   if (!list_empty (&sema->waiters)) 
-    thread_unblock (list_entry (list_pop_front (&sema->waiters),
-                                struct thread, elem));
+    {
+      struct thread *t = list_entry (list_pop_front (&sema->waiters),
+                                     struct thread, elem);
+      t->waiting_sema = NULL;
+      thread_unblock (t);
+    }
   sema->value++;
+  thread_preempt ();
   intr_set_level (old_level);
 }
 
@@ -163,23 +254,138 @@ sema_test_helper (void *sema_)
    is, it is an error for the thread currently holding a lock to
    try to acquire that lock.
 
-   A lock is a specialization of a semaphore with an initial
-   value of 1.  The difference between a lock and such a
-   semaphore is twofold.  First, a semaphore can have a value
-   greater than 1, but a lock can only be owned by a single
-   thread at a time.  Second, a semaphore does not have an owner,
-   meaning that one thread can "down" the semaphore and then
-   another one "up" it, but with a lock the same thread must both
-   acquire and release it.  When these restrictions prove
-   onerous, it's a good sign that a semaphore should be used,
-   instead of a lock. */
+   A lock is like a semaphore with an initial value of 1.  The
+   difference between a lock and such a semaphore is twofold.
+   First, a semaphore can have a value greater than 1, but a lock
+   can only be owned by a single thread at a time.  Second, a
+   semaphore does not have an owner, meaning that one thread can
+   "down" the semaphore and then another one "up" it, but with a
+   lock the same thread must both acquire and release it.  When
+   these restrictions prove onerous, it's a good sign that a
+   semaphore should be used, instead of a lock.
+
+   A free lock is taken, and a lock without waiters is released,
+   with a single compare-and-exchange on LOCK->holder, without
+   disabling interrupts.  The low bit of LOCK->holder, LOCK_WAITERS,
+   is set while threads wait for the lock; it forces the holder's
+   release down the slow path, which hands the lock directly to
+   the highest-priority waiter.  Only a lock with waiters is on
+   its holder's held_locks list, because only such a lock can
+   carry a priority donation. */
 void
 lock_init (struct lock *lock)
 {
   ASSERT (lock != NULL);
 
   lock->holder = NULL;
-  sema_init (&lock->semaphore, 1);
+  list_init (&lock->waiters);
+  lock->max_priority = PRI_MIN;
+  lock->class = NULL;
+}
+
+/* Initializes LOCK like lock_init(), and records statistics for
+   it under NAME if the "-lockstat" option is given.  Locks with
+   the same NAME share statistics.  NAME must remain valid
+   forever; normally it is a string literal. */
+void
+lock_init_named (struct lock *lock, const char *name) 
+{
+  enum intr_level old_level;
+  int i;
+
+  ASSERT (name != NULL);
+
+  lock_init (lock);
+
+  old_level = intr_disable ();
+  for (i = 0; i < lock_class_cnt; i++)
+    if (!strcmp (lock_classes[i].name, name))
+      break;
+  if (i == lock_class_cnt && lock_class_cnt < LOCK_CLASS_CNT)
+    lock_classes[lock_class_cnt++].name = name;
+  if (i < lock_class_cnt)
+    lock->class = &lock_classes[i];
+  intr_set_level (old_level);
+}
+
+/* If *P equals OLD, sets it to NEW.  Returns the previous value
+   of *P either way.  Pintos runs on a single CPU, so the
+   instruction need not be locked to be atomic. */
+static inline struct thread *
+compare_exchange (struct thread **p, struct thread *old, struct thread *new)
+{
+  struct thread *prev;
+
+  asm volatile ("cmpxchgl %2, %1"
+                : "=a" (prev), "+m" (*p)
+                : "r" (new), "0" (old)
+                : "memory");
+  return prev;
+}
+
+/* Returns the thread holding LOCK, or a null pointer if it is
+   free. */
+static inline struct thread *
+lock_holder (const struct lock *lock) 
+{
+  return (struct thread *) ((uintptr_t) lock->holder & ~LOCK_WAITERS);
+}
+
+/* Donates T's priority to the holder of the lock that T is
+   waiting on, then to the holder of the lock that that thread is
+   waiting on, and so on, following at most LOCK_DONATE_DEPTH
+   links of the chain.  Interrupts must be off. */
+static void
+donate_priority (struct thread *t) 
+{
+  int depth;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (depth = 0; depth < LOCK_DONATE_DEPTH && t->waiting_lock != NULL;
+       depth++) 
+    {
+      struct lock *lock = t->waiting_lock;
+      struct thread *holder = lock_holder (lock);
+
+      if (lock->max_priority < t->priority)
+        lock->max_priority = t->priority;
+      if (holder == NULL || holder->priority >= t->priority)
+        break;
+      thread_update_priority (holder);
+      t = holder;
+    }
+}
+
+/* Recomputes the priority of T, a lock holder from which a
+   donation has just been withdrawn, then that of the holder of
+   the lock that T is waiting on, and so on, following at most
+   LOCK_DONATE_DEPTH links of the chain, like donate_priority().
+   Interrupts must be off. */
+static void
+withdraw_priority (struct thread *t) 
+{
+  int depth;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (depth = 0; depth < LOCK_DONATE_DEPTH; depth++) 
+    {
+      int old_priority = t->priority;
+      struct lock *lock;
+
+      thread_update_priority (t);
+      lock = t->waiting_lock;
+      if (t->priority == old_priority || lock == NULL)
+        break;
+
+      /* T is on LOCK's waiter list, so the list is not empty. */
+      lock->max_priority = list_entry (list_front (&lock->waiters),
+                                       struct thread, elem)->priority;
+      t = lock_holder (lock);
+      if (t == NULL)
+        break;
+    }
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -193,12 +399,124 @@ lock_init (struct lock *lock)
 void
 lock_acquire (struct lock *lock)
 {
+  lock_acquire_wait (lock, WAIT_FOREVER);
+}
+
+/* Like lock_acquire(), but gives up if LOCK does not become
+   available within TICKS timer ticks.  Returns true if LOCK was
+   acquired, false if the wait timed out.  If TICKS is zero or
+   negative, does not wait at all, like lock_try_acquire().
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+bool
+lock_acquire_timeout (struct lock *lock, int64_t ticks) 
+{
+  if (ticks <= 0)
+    return lock_try_acquire (lock);
+  return lock_acquire_wait (lock, ticks);
+}
+
+/* Acquires LOCK, giving up after TICKS timer ticks unless TICKS
+   is WAIT_FOREVER.  Returns true if LOCK was acquired, false if
+   the wait timed out. */
+static bool
+lock_acquire_wait (struct lock *lock, int64_t ticks) 
+{
+  struct thread *curr = thread_current ();
+  struct thread *holder;
+  enum intr_level old_level;
+  int64_t start = 0;
+  bool success;
+
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
-  sema_down (&lock->semaphore);
-  lock->holder = thread_current ();
+  /* Fast path: take a free lock. */
+  if (compare_exchange (&lock->holder, NULL, curr) == NULL) 
+    {
+      if (lock_stats && lock->class != NULL) 
+        {
+          old_level = intr_disable ();
+          lock_acquired (lock, false, 0);
+          intr_set_level (old_level);
+        }
+      return true;
+    }
+
+  /* Slow path: wait for the holder to hand the lock over. */
+  old_level = intr_disable ();
+  holder = lock_holder (lock);
+  if (holder == NULL) 
+    {
+      /* Released since the compare-and-exchange. */
+      lock->holder = curr;
+      lock_acquired (lock, false, 0);
+      intr_set_level (old_level);
+      return true;
+    }
+
+  if (lock_stats && lock->class != NULL)
+    start = timer_ns ();
+  if (list_empty (&lock->waiters)) 
+    {
+      lock->holder = (struct thread *) ((uintptr_t) holder | LOCK_WAITERS);
+      lock->max_priority = PRI_MIN;
+      list_push_back (&holder->held_locks, &lock->elem);
+    }
+  list_insert_ordered (&lock->waiters, &curr->elem,
+                       thread_more_priority, NULL);
+  curr->waiting_lock = lock;
+
+  /* Lend our priority to the holder while we wait. */
+  if (!thread_mlfqs)
+    donate_priority (curr);
+  else if (lock->max_priority < curr->priority)
+    lock->max_priority = curr->priority;
+
+  if (ticks != WAIT_FOREVER)
+    timeout_start (curr, ticks);
+  thread_block ();
+  if (ticks != WAIT_FOREVER)
+    timer_cancel (&curr->sleep_callout);
+
+  /* Either LOCK was handed to us or timeout() took us off its
+     waiter list. */
+  success = lock_holder (lock) == curr;
+  if (success)
+    lock_acquired (lock, true, start);
+  intr_set_level (old_level);
+
+  return success;
+}
+
+/* Removes T, whose wait has timed out, from the waiter list of
+   the lock that it is waiting on, and withdraws its donation
+   from the holder and from any threads that the holder is in
+   turn donating to.  If T was the last waiter, the holder can again release the
+   lock on the fast path.  Interrupts must be off. */
+static void
+lock_remove_waiter (struct thread *t) 
+{
+  struct lock *lock = t->waiting_lock;
+  struct thread *holder = lock_holder (lock);
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_remove (&t->elem);
+  t->waiting_lock = NULL;
+  if (list_empty (&lock->waiters)) 
+    {
+      lock->holder = holder;
+      lock->max_priority = PRI_MIN;
+      list_remove (&lock->elem);
+    }
+  else
+    lock->max_priority = list_entry (list_front (&lock->waiters),
+                                     struct thread, elem)->priority;
+  if (!thread_mlfqs)
+    withdraw_priority (holder);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -210,19 +528,25 @@ lock_acquire (struct lock *lock)
 bool
 lock_try_acquire (struct lock *lock)
 {
-  bool success;
+  enum intr_level old_level;
 
   ASSERT (lock != NULL);
   ASSERT (!lock_held_by_current_thread (lock));
 
-  success = sema_try_down (&lock->semaphore);
-  if (success)
-    lock->holder = thread_current ();
-  return success;
+  if (compare_exchange (&lock->holder, NULL, thread_current ()) != NULL)
+    return false;
+
+  if (lock_stats && lock->class != NULL) 
+    {
+      old_level = intr_disable ();
+      lock_acquired (lock, false, 0);
+      intr_set_level (old_level);
+    }
+  return true;
 }
 
 /* Releases LOCK, which must be owned by the current thread.
-   This is lock_release function.
+   Gives up any priority donated through LOCK.
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to release a lock within an interrupt
@@ -230,11 +554,56 @@ lock_try_acquire (struct lock *lock)
 void
 lock_release (struct lock *lock) 
 {
+  struct thread *curr = thread_current ();
+  struct thread *next;
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
-  lock->holder = NULL;
-  sema_up (&lock->semaphore);
+  if (lock_stats && lock->class != NULL) 
+    {
+      int64_t hold;
+
+      old_level = intr_disable ();
+      hold = timer_ns () - lock->acquired;
+      if (hold > lock->class->max_hold)
+        lock->class->max_hold = hold;
+      intr_set_level (old_level);
+    }
+
+  /* Fast path: no one is waiting. */
+  if (compare_exchange (&lock->holder, curr, NULL) == curr)
+    return;
+
+  /* Slow path: give up LOCK's donation and hand LOCK to the
+     highest-priority waiter. */
+  old_level = intr_disable ();
+  list_remove (&lock->elem);
+  if (!thread_mlfqs)
+    thread_update_priority (curr);
+
+  next = list_entry (list_pop_front (&lock->waiters), struct thread, elem);
+  next->waiting_lock = NULL;
+  if (list_empty (&lock->waiters)) 
+    {
+      lock->holder = next;
+      lock->max_priority = PRI_MIN;
+    }
+  else 
+    {
+      /* The remaining waiters donate to NEXT. */
+      struct thread *front = list_entry (list_front (&lock->waiters),
+                                         struct thread, elem);
+      lock->holder = (struct thread *) ((uintptr_t) next | LOCK_WAITERS);
+      lock->max_priority = front->priority;
+      list_push_back (&next->held_locks, &lock->elem);
+      if (!thread_mlfqs)
+        thread_update_priority (next);
+    }
+  thread_unblock (next);
+  thread_preempt ();
+  intr_set_level (old_level);
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -245,14 +614,73 @@ lock_held_by_current_thread (const struct lock *lock)
 {
   ASSERT (lock != NULL);
 
-  return lock->holder == thread_current ();
+  return lock_holder (lock) == thread_current ();
 }
-
+
+/* Updates the statistics for LOCK, which the current thread has
+   just acquired.  If CONTENDED, it had to wait for LOCK starting
+   at time START.  Interrupts must be off. */
+static void
+lock_acquired (struct lock *lock, bool contended, int64_t start) 
+{
+  struct lock_class *class = lock->class;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!lock_stats || class == NULL)
+    return;
+
+  lock->acquired = timer_ns ();
+  class->acquisitions++;
+  if (contended) 
+    {
+      int64_t wait = lock->acquired - start;
+
+      class->contended++;
+      class->wait_time += wait;
+      if (wait > class->max_wait)
+        class->max_wait = wait;
+    }
+}
+
+/* Prints statistics for the named locks with the most contended
+   acquisitions, if the "-lockstat" option was given. */
+void
+lock_print_stats (void) 
+{
+  bool printed[LOCK_CLASS_CNT];
+  int i, n;
+
+  if (!lock_stats)
+    return;
+
+  memset (printed, 0, sizeof printed);
+  for (n = 0; n < LOCK_STATS_TOP && n < lock_class_cnt; n++) 
+    {
+      struct lock_class *c;
+      int max = -1;
+
+      for (i = 0; i < lock_class_cnt; i++)
+        if (!printed[i]
+            && (max < 0
+                || lock_classes[i].contended > lock_classes[max].contended))
+          max = i;
+      printed[max] = true;
+
+      c = &lock_classes[max];
+      printf ("Lock %s: %u acquisitions, %u contended, "
+              "%lld us waiting (max %lld), max hold %lld us\n",
+              c->name, c->acquisitions, c->contended,
+              c->wait_time / 1000, c->max_wait / 1000, c->max_hold / 1000);
+    }
+}
+
 /* One semaphore in a list. */
 struct semaphore_elem 
   {
     struct list_elem elem;              /* List element. */
     struct semaphore semaphore;         /* This semaphore. */
+    struct thread *thread;              /* Thread waiting on it. */
   };
 
 /* Initializes condition variable COND.  A condition variable
@@ -288,8 +716,39 @@ cond_init (struct condition *cond)
    we need to sleep. */
 void
 cond_wait (struct condition *cond, struct lock *lock) 
+{
+  cond_wait_wait (cond, lock, WAIT_FOREVER);
+}
+
+/* Like cond_wait(), but stops waiting for COND to be signaled
+   after TICKS timer ticks.  LOCK is reacquired before returning
+   either way, which may take longer.  Returns true if COND was
+   signaled, false if the wait timed out.  If TICKS is zero or
+   negative, returns false at once, without releasing LOCK.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+bool
+cond_wait_timeout (struct condition *cond, struct lock *lock,
+                   int64_t ticks) 
+{
+  ASSERT (lock_held_by_current_thread (lock));
+
+  if (ticks <= 0)
+    return false;
+  return cond_wait_wait (cond, lock, ticks);
+}
+
+/* Releases LOCK, waits for COND to be signaled, giving up after
+   TICKS timer ticks unless TICKS is WAIT_FOREVER, and reacquires
+   LOCK.  Returns true if COND was signaled, false if the wait
+   timed out. */
+static bool
+cond_wait_wait (struct condition *cond, struct lock *lock, int64_t ticks) 
 {
   struct semaphore_elem waiter;
+  enum intr_level old_level;
+  bool signaled;
 
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
@@ -297,15 +756,40 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (lock_held_by_current_thread (lock));
   
   sema_init (&waiter.semaphore, 0);
-  list_push_back (&cond->waiters, &waiter.elem);
+  waiter.thread = thread_current ();
+
+  /* Donation can reorder COND's waiters without holding LOCK, so
+     the list is only modified with interrupts off. */
+  old_level = intr_disable ();
+  list_insert_ordered (&cond->waiters, &waiter.elem,
+                       waiter_more_priority, NULL);
+  waiter.thread->waiting_cond = cond;
+  intr_set_level (old_level);
+
   lock_release (lock);
-  sema_down (&waiter.semaphore);
+  signaled = sema_down_wait (&waiter.semaphore, ticks);
+  if (!signaled) 
+    {
+      /* Timed out, but cond_signal() may have picked us since.
+         If so, its sema_up() counts as the signal. */
+      old_level = intr_disable ();
+      if (waiter.thread->waiting_cond != NULL) 
+        {
+          list_remove (&waiter.elem);
+          waiter.thread->waiting_cond = NULL;
+        }
+      else
+        signaled = sema_try_down (&waiter.semaphore);
+      intr_set_level (old_level);
+    }
   lock_acquire (lock);
+
+  return signaled;
 }
 
 /* If any threads are waiting on COND (protected by LOCK), then
-   this function signals one of them to wake up from its wait.
-   LOCK must be held before calling this function.
+   this function signals the highest-priority one to wake up from
+   its wait.  LOCK must be held before calling this function.
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to signal a condition variable within an
@@ -313,14 +797,23 @@ cond_wait (struct condition *cond, struct lock *lock)
 void
 cond_signal (struct condition *cond, struct lock *lock UNUSED) 
 {
+  enum intr_level old_level;
+
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
   if (!list_empty (&cond->waiters)) 
-    sema_up (&list_entry (list_pop_front (&cond->waiters),
-                          struct semaphore_elem, elem)->semaphore);
+    {
+      struct semaphore_elem *waiter
+        = list_entry (list_pop_front (&cond->waiters),
+                      struct semaphore_elem, elem);
+      waiter->thread->waiting_cond = NULL;
+      sema_up (&waiter->semaphore);
+    }
+  intr_set_level (old_level);
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -338,3 +831,443 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   while (!list_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+/* Initializes readers-writer lock RWL.  Any number of threads
+   may hold RWL shared ("for reading") at once, or a single thread
+   may hold it exclusive ("for writing").
+
+   Writers are preferred: once a writer is waiting, new readers
+   wait until it is done, so that a stream of readers cannot
+   starve writers.  It follows that a thread must not acquire RWL
+   for reading while it already holds it, because a writer
+   arriving in between would deadlock the two. */
+void
+rwlock_init (struct rwlock *rwl) 
+{
+  ASSERT (rwl != NULL);
+
+  lock_init (&rwl->lock);
+  cond_init (&rwl->readers_ok);
+  cond_init (&rwl->writers_ok);
+  cond_init (&rwl->upgrade_ok);
+  rwl->readers = 0;
+  rwl->waiting_writers = 0;
+  rwl->writer = NULL;
+  rwl->upgrader = NULL;
+}
+
+/* Acquires RWL for reading, sleeping until no thread holds it
+   for writing or is waiting to. */
+void
+rwlock_acquire_read (struct rwlock *rwl) 
+{
+  ASSERT (rwl != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (rwl->writer != thread_current ());
+
+  lock_acquire (&rwl->lock);
+  while (rwl->writer != NULL || rwl->waiting_writers > 0
+         || rwl->upgrader != NULL)
+    cond_wait (&rwl->readers_ok, &rwl->lock);
+  rwl->readers++;
+  lock_release (&rwl->lock);
+}
+
+/* Wakes up whichever waiter may now proceed after the number of
+   readers of RWL has dropped.  RWL's internal lock must be
+   held. */
+static void
+rwlock_reader_left (struct rwlock *rwl) 
+{
+  if (rwl->upgrader != NULL) 
+    {
+      if (rwl->readers == 1)
+        cond_signal (&rwl->upgrade_ok, &rwl->lock);
+    }
+  else if (rwl->readers == 0 && rwl->waiting_writers > 0)
+    cond_signal (&rwl->writers_ok, &rwl->lock);
+}
+
+/* Releases RWL, which the current thread must hold for
+   reading. */
+void
+rwlock_release_read (struct rwlock *rwl) 
+{
+  ASSERT (rwl != NULL);
+
+  lock_acquire (&rwl->lock);
+  ASSERT (rwl->readers > 0);
+  rwl->readers--;
+  rwlock_reader_left (rwl);
+  lock_release (&rwl->lock);
+}
+
+/* Acquires RWL for writing, sleeping until no other thread holds
+   it. */
+void
+rwlock_acquire_write (struct rwlock *rwl) 
+{
+  ASSERT (rwl != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (rwl->writer != thread_current ());
+
+  lock_acquire (&rwl->lock);
+  rwl->waiting_writers++;
+  while (rwl->writer != NULL || rwl->readers > 0 || rwl->upgrader != NULL)
+    cond_wait (&rwl->writers_ok, &rwl->lock);
+  rwl->waiting_writers--;
+  rwl->writer = thread_current ();
+  lock_release (&rwl->lock);
+}
+
+/* Releases RWL, which the current thread must hold for writing.
+   Hands RWL to a waiting writer if there is one, otherwise to
+   all the waiting readers. */
+void
+rwlock_release_write (struct rwlock *rwl) 
+{
+  ASSERT (rwl != NULL);
+  ASSERT (rwlock_held_for_write (rwl));
+
+  lock_acquire (&rwl->lock);
+  rwl->writer = NULL;
+  if (rwl->waiting_writers > 0)
+    cond_signal (&rwl->writers_ok, &rwl->lock);
+  else
+    cond_broadcast (&rwl->readers_ok, &rwl->lock);
+  lock_release (&rwl->lock);
+}
+
+/* Converts the current thread's hold on RWL from reading to
+   writing, sleeping until every other reader has released it.
+   The upgrade takes precedence over waiting writers.
+
+   Only one thread can be upgrading at a time.  If another thread
+   already is, returns false after releasing the current thread's
+   hold on RWL entirely; the caller must then acquire RWL again
+   and recheck whatever it read.  Otherwise returns true. */
+bool
+rwlock_upgrade (struct rwlock *rwl) 
+{
+  ASSERT (rwl != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rwl->lock);
+  ASSERT (rwl->readers > 0);
+  if (rwl->upgrader != NULL) 
+    {
+      rwl->readers--;
+      rwlock_reader_left (rwl);
+      lock_release (&rwl->lock);
+      return false;
+    }
+
+  rwl->upgrader = thread_current ();
+  while (rwl->readers > 1)
+    cond_wait (&rwl->upgrade_ok, &rwl->lock);
+  rwl->upgrader = NULL;
+  rwl->readers = 0;
+  rwl->writer = thread_current ();
+  lock_release (&rwl->lock);
+  return true;
+}
+
+/* Converts the current thread's hold on RWL from writing to
+   reading.  Waiting readers are let in too, unless a writer is
+   waiting. */
+void
+rwlock_downgrade (struct rwlock *rwl) 
+{
+  ASSERT (rwl != NULL);
+  ASSERT (rwlock_held_for_write (rwl));
+
+  lock_acquire (&rwl->lock);
+  rwl->writer = NULL;
+  rwl->readers = 1;
+  if (rwl->waiting_writers == 0)
+    cond_broadcast (&rwl->readers_ok, &rwl->lock);
+  lock_release (&rwl->lock);
+}
+
+/* Returns true if the current thread holds RWL for writing,
+   false otherwise. */
+bool
+rwlock_held_for_write (const struct rwlock *rwl) 
+{
+  ASSERT (rwl != NULL);
+
+  return rwl->writer == thread_current ();
+}
+
+/* Blocks the current thread on WAITERS.  Interrupts must be
+   off. */
+static void
+wait_on (struct list *waiters) 
+{
+  ASSERT (!intr_context ());
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_push_back (waiters, &thread_current ()->elem);
+  thread_block ();
+}
+
+/* Wakes up every thread on WAITERS, then yields once if any of
+   them outranks the running thread.  Interrupts must be off. */
+static void
+wake_all (struct list *waiters) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (list_empty (waiters))
+    return;
+  while (!list_empty (waiters))
+    thread_unblock (list_entry (list_pop_front (waiters),
+                                struct thread, elem));
+  thread_preempt ();
+}
+
+/* Initializes COMPLETION, which is not yet completed. */
+void
+completion_init (struct completion *completion) 
+{
+  ASSERT (completion != NULL);
+
+  completion->done = false;
+  list_init (&completion->waiters);
+}
+
+/* Waits until COMPLETION is completed.  Returns immediately if
+   it already is.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+completion_wait (struct completion *completion) 
+{
+  enum intr_level old_level;
+
+  ASSERT (completion != NULL);
+
+  old_level = intr_disable ();
+  if (!completion->done)
+    wait_on (&completion->waiters);
+  intr_set_level (old_level);
+}
+
+/* Completes COMPLETION, waking up all the threads waiting for
+   it.  A completion cannot be completed twice.
+
+   This function may be called from an interrupt handler. */
+void
+complete (struct completion *completion) 
+{
+  enum intr_level old_level;
+
+  ASSERT (completion != NULL);
+
+  old_level = intr_disable ();
+  ASSERT (!completion->done);
+  completion->done = true;
+  wake_all (&completion->waiters);
+  intr_set_level (old_level);
+}
+
+/* Returns true if COMPLETION has been completed, false
+   otherwise. */
+bool
+completion_done (const struct completion *completion) 
+{
+  ASSERT (completion != NULL);
+
+  return completion->done;
+}
+
+/* Initializes LATCH to open after COUNT calls to
+   latch_count_down().  A latch with COUNT 0 is open from the
+   start. */
+void
+latch_init (struct latch *latch, unsigned count) 
+{
+  ASSERT (latch != NULL);
+
+  latch->count = count;
+  list_init (&latch->waiters);
+}
+
+/* Decrements LATCH's count, waking up all the threads waiting on
+   LATCH if it reaches zero.
+
+   This function may be called from an interrupt handler. */
+void
+latch_count_down (struct latch *latch) 
+{
+  enum intr_level old_level;
+
+  ASSERT (latch != NULL);
+
+  old_level = intr_disable ();
+  ASSERT (latch->count > 0);
+  if (--latch->count == 0)
+    wake_all (&latch->waiters);
+  intr_set_level (old_level);
+}
+
+/* Waits until LATCH's count reaches zero.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+latch_wait (struct latch *latch) 
+{
+  enum intr_level old_level;
+
+  ASSERT (latch != NULL);
+
+  old_level = intr_disable ();
+  if (latch->count > 0)
+    wait_on (&latch->waiters);
+  intr_set_level (old_level);
+}
+
+/* Initializes BARRIER for groups of PARTIES threads. */
+void
+barrier_init (struct barrier *barrier, unsigned parties) 
+{
+  ASSERT (barrier != NULL);
+  ASSERT (parties > 0);
+
+  barrier->parties = parties;
+  barrier->arrived = 0;
+  list_init (&barrier->waiters);
+}
+
+/* Waits until BARRIER's number of parties, counting the current
+   thread, have called this function, then wakes them all up.
+   BARRIER is then ready for reuse by the next group.  Returns
+   true in exactly one thread of each group, the last to arrive,
+   and false in the others.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+bool
+barrier_wait (struct barrier *barrier) 
+{
+  enum intr_level old_level;
+  bool last;
+
+  ASSERT (barrier != NULL);
+
+  old_level = intr_disable ();
+  last = ++barrier->arrived == barrier->parties;
+  if (last) 
+    {
+      barrier->arrived = 0;
+      wake_all (&barrier->waiters);
+    }
+  else
+    wait_on (&barrier->waiters);
+  intr_set_level (old_level);
+
+  return last;
+}
+
+/* Arranges for timeout() to take T off whatever it is waiting on
+   after TICKS timer ticks.  Uses T's sleep callout, which is free
+   because T cannot be in timer_sleep() at the same time.
+   Interrupts must be off. */
+static void
+timeout_start (struct thread *t, int64_t ticks) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  callout_init (&t->sleep_callout, timeout, t, CALLOUT_IRQ);
+  timer_schedule (&t->sleep_callout, ticks);
+}
+
+/* Returns true if T's wait with the given TICKS timeout, started
+   with timeout_start() unless TICKS is WAIT_FOREVER, has timed
+   out. */
+static bool
+timeout_expired (struct thread *t, int64_t ticks) 
+{
+  return ticks != WAIT_FOREVER && !t->sleep_callout.pending;
+}
+
+/* Callout function, run in the timer interrupt, that ends the
+   wait of THREAD if it is still waiting on a semaphore or lock,
+   and yields on return from the interrupt if THREAD outranks the
+   running thread.  The waiter lists are doubly linked, so this
+   takes constant time. */
+static void
+timeout (void *thread) 
+{
+  struct thread *t = thread;
+
+  if (t->waiting_sema != NULL) 
+    {
+      list_remove (&t->elem);
+      t->waiting_sema = NULL;
+    }
+  else if (t->waiting_lock != NULL)
+    lock_remove_waiter (t);
+  else
+    return;
+  thread_unblock (t);
+  thread_preempt ();
+}
+
+/* Moves T, whose priority has just changed, to its new place in
+   the waiter list of the semaphore or condition variable that it
+   is waiting on, if any.  Interrupts must be off. */
+void
+synch_requeue (struct thread *t) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->waiting_sema != NULL) 
+    {
+      list_remove (&t->elem);
+      list_insert_ordered (&t->waiting_sema->waiters, &t->elem,
+                           thread_more_priority, NULL);
+    }
+  if (t->waiting_lock != NULL) 
+    {
+      list_remove (&t->elem);
+      list_insert_ordered (&t->waiting_lock->waiters, &t->elem,
+                           thread_more_priority, NULL);
+    }
+  if (t->waiting_cond != NULL) 
+    {
+      struct list *waiters = &t->waiting_cond->waiters;
+      struct list_elem *e;
+
+      for (e = list_begin (waiters); e != list_end (waiters);
+           e = list_next (e))
+        if (list_entry (e, struct semaphore_elem, elem)->thread == t) 
+          {
+            list_remove (e);
+            list_insert_ordered (waiters, e, waiter_more_priority, NULL);
+            break;
+          }
+    }
+}
+
+/* Returns true if the thread whose `elem' is A has a higher
+   priority than the thread whose `elem' is B. */
+static bool
+thread_more_priority (const struct list_elem *a, const struct list_elem *b,
+                      void *aux UNUSED) 
+{
+  return (list_entry (a, struct thread, elem)->priority
+          > list_entry (b, struct thread, elem)->priority);
+}
+
+/* Returns true if the thread waiting on semaphore_elem A has a
+   higher priority than the thread waiting on semaphore_elem B. */
+static bool
+waiter_more_priority (const struct list_elem *a, const struct list_elem *b,
+                      void *aux UNUSED) 
+{
+  return (list_entry (a, struct semaphore_elem, elem)->thread->priority
+          > list_entry (b, struct semaphore_elem, elem)->thread->priority);
+}
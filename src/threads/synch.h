@@ -3,44 +3,126 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+struct thread;
 
 /* A counting semaphore. */
 struct semaphore 
   {
     unsigned value;             /* Current value. */
-    struct list waiters;        /* List of waiting threads. */
+    struct list waiters;        /* Waiting threads, highest priority first. */
   };
 
 void sema_init (struct semaphore *, unsigned value);
 void sema_down (struct semaphore *);
+bool sema_down_timeout (struct semaphore *, int64_t ticks);
 bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
 void sema_self_test (void);
 
+/* Maximum number of lock holders that a single lock_acquire()
+   donates priority to, when the holder of the lock is itself
+   waiting on a lock held by another thread, and so on. */
+#define LOCK_DONATE_DEPTH 8
+
+/* Bit set in a lock's `holder' while threads wait for it. */
+#define LOCK_WAITERS 0x1
+
 /* Lock. */
 struct lock 
   {
-    struct thread *holder;      /* Thread holding lock (for debugging). */
-    struct semaphore semaphore; /* Binary semaphore controlling access. */
+    struct thread *holder;      /* Thread holding lock, | LOCK_WAITERS. */
+    struct list waiters;        /* Waiting threads, highest priority first. */
+    struct list_elem elem;      /* Element in holder's held_locks list. */
+    int max_priority;           /* Highest priority of any waiter. */
+    struct lock_class *class;   /* Statistics, or null if unnamed. */
+    int64_t acquired;           /* timer_ns() when acquired, for stats. */
   };
 
+/* If true, collect statistics for named locks.
+   Controlled by kernel command-line option "-lockstat". */
+extern bool lock_stats;
+
 void lock_init (struct lock *);
+void lock_init_named (struct lock *, const char *name);
 void lock_acquire (struct lock *);
+bool lock_acquire_timeout (struct lock *, int64_t ticks);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
+void lock_print_stats (void);
 
 /* Condition variable. */
 struct condition 
   {
-    struct list waiters;        /* List of waiting threads. */
+    struct list waiters;        /* Waiting threads, highest priority first. */
   };
 
 void cond_init (struct condition *);
 void cond_wait (struct condition *, struct lock *);
+bool cond_wait_timeout (struct condition *, struct lock *, int64_t ticks);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Readers-writer lock. */
+struct rwlock 
+  {
+    struct lock lock;           /* Protects the members below. */
+    struct condition readers_ok; /* Signaled when readers may enter. */
+    struct condition writers_ok; /* Signaled when a writer may enter. */
+    struct condition upgrade_ok; /* Signaled when an upgrade may finish. */
+    int readers;                /* Number of threads holding it shared. */
+    int waiting_writers;        /* Number of threads waiting to write. */
+    struct thread *writer;      /* Thread holding it exclusive. */
+    struct thread *upgrader;    /* Reader waiting to upgrade. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_upgrade (struct rwlock *);
+void rwlock_downgrade (struct rwlock *);
+bool rwlock_held_for_write (const struct rwlock *);
+
+/* One-shot completion: threads wait until it is completed. */
+struct completion 
+  {
+    bool done;                  /* Completed yet? */
+    struct list waiters;        /* Waiting threads. */
+  };
+
+void completion_init (struct completion *);
+void completion_wait (struct completion *);
+void complete (struct completion *);
+bool completion_done (const struct completion *);
+
+/* Countdown latch: threads wait until the count reaches zero. */
+struct latch 
+  {
+    unsigned count;             /* Count downs remaining. */
+    struct list waiters;        /* Waiting threads. */
+  };
+
+void latch_init (struct latch *, unsigned count);
+void latch_count_down (struct latch *);
+void latch_wait (struct latch *);
+
+/* Reusable barrier for a fixed number of threads. */
+struct barrier 
+  {
+    unsigned parties;           /* Threads that must arrive. */
+    unsigned arrived;           /* Threads arrived in this round. */
+    struct list waiters;        /* Waiting threads. */
+  };
+
+void barrier_init (struct barrier *, unsigned parties);
+bool barrier_wait (struct barrier *);
+
+void synch_requeue (struct thread *);
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
@@ -11,6 +11,8 @@
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "threads/workqueue.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -24,9 +26,22 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Number of distinct thread priorities. */
+#define PRI_CNT (PRI_MAX - PRI_MIN + 1)
+
+/* Run queues of processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running.
+   There is one FIFO queue per priority level.  Bit P of
+   ready_levels is set if and only if ready_queues[P - PRI_MIN]
+   is nonempty, so the highest nonempty level is found with a
+   single bit scan instead of a walk over every ready thread. */
+static struct list ready_queues[PRI_CNT];
+static uint64_t ready_levels;
+static int ready_cnt;           /* # of threads in ready_queues. */
+
+/* List of all processes.  Processes are added to this list
+   when they are created and removed when they exit. */
+static struct list all_list;
 
 /* Idle thread. */
 static struct thread *idle_thread;
@@ -37,6 +52,23 @@ static struct thread *initial_thread;
 /* Lock used by allocate_tid(). */
 static struct lock tid_lock;
 
+/* Pages of exited threads, kept for reuse by thread_create() so
+   that thread churn bypasses the page allocator.  Only
+   init_thread() clears a reused page, and only its struct thread:
+   the rest of the page is stack that is written before it is
+   read.  Accessed only with interrupts off. */
+#define PAGE_CACHE_SIZE 8
+static void *page_cache[PAGE_CACHE_SIZE];
+static int page_cache_cnt;
+
+/* Dead threads whose pages are waiting to be freed.
+   schedule_tail() runs with interrupts off, so instead of freeing
+   a dying thread's page itself, it just adds the thread to this
+   list and submits reap_work, which frees pages in batches with
+   interrupts on. */
+static struct list reap_list;
+static struct work reap_work;
+
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame 
   {
@@ -49,24 +81,78 @@ struct kernel_thread_frame
 static long long idle_ticks;    /* # of timer ticks spent idle. */
 static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
 static long long user_ticks;    /* # of timer ticks in user programs. */
+static unsigned latency_hist[LATENCY_BUCKETS]; /* Wakeup-to-run latency. */
+static long long switch_cnt;    /* # of context switches. */
 
 /* Scheduling. */
-#define TIME_SLICE 4            /* # of timer ticks to give each thread. */
-static unsigned thread_ticks;   /* # of timer ticks since last yield. */
+int thread_time_slice = 4;      /* # of timer ticks to give each thread. */
+static int thread_ticks;        /* # of timer ticks since last yield. */
+static bool yield_preempted;    /* Was the yielding thread preempted? */
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* Adaptive time slices.
+
+   A thread that blocks before its time slice runs out is taken to
+   be I/O-bound: its slice is halved, down to 1 tick, and it gets a
+   priority bonus of 1, up to SLICE_BONUS_MAX.  A thread that uses
+   up its whole slice is taken to be CPU-bound: its slice doubles,
+   up to SLICE_GROWTH times the default, and it loses its bonus.
+   Under the MLFQS, which sets priorities itself, only the slice
+   adapts. */
+bool thread_adaptive_slice;
+#define SLICE_GROWTH 4          /* Longest slice, in default slices. */
+#define SLICE_BONUS_MAX 3       /* Largest priority bonus. */
+
+/* Multi-level feedback queue scheduler.
+
+   A thread whose recent_cpu and nice are both zero keeps
+   recent_cpu at zero and its priority at PRI_MAX across the
+   once-per-second decay, so only threads with a nonzero value
+   are kept on mlfqs_active and visited by that update.  Threads
+   drop off again once their recent_cpu decays back to zero.
+
+   Between seconds, recent_cpu changes only for the running
+   thread, so each thread that runs during a tick is put on
+   mlfqs_dirty, and only those threads have their priority
+   recalculated every MLFQS_PRI_TICKS ticks.  The recalculation,
+   and the once-per-second update, run from timer callouts of
+   their own, since TIMER_FREQ need not be a multiple of
+   MLFQS_PRI_TICKS. */
+#define MLFQS_PRI_TICKS 4       /* # of ticks between recalculations. */
+static fixed_t load_avg;        /* System load average. */
+static struct callout mlfqs_callout; /* Calls mlfqs_recalculate(). */
+static struct callout mlfqs_second_callout; /* Calls mlfqs_second(). */
+static struct list mlfqs_active; /* Threads with nonzero recent_cpu or nice. */
+static struct list mlfqs_dirty; /* Threads needing a new priority. */
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
 static struct thread *running_thread (void);
 static struct thread *next_thread_to_run (void);
+static void ready_queue_push (struct thread *);
+static void ready_queue_remove (struct thread *);
+static int ready_queue_max_priority (void);
+static void change_priority (struct thread *, int priority);
+static void yield (bool preempted);
+static void adapt_slice (struct thread *, bool expired);
+static void account_switch (struct thread *prev, struct thread *next);
+static void mlfqs_recalculate (void *aux);
+static void mlfqs_second (void *aux);
+static void mlfqs_mark_active (struct thread *);
+static void mlfqs_mark_dirty (struct thread *);
+static int mlfqs_priority (const struct thread *);
 static void init_thread (struct thread *, const char *name, int priority);
 static bool is_thread (struct thread *) UNUSED;
 static void *alloc_frame (struct thread *, size_t size);
+static struct thread *alloc_thread_page (void);
+static void free_thread_page (struct thread *);
+static void reap (struct thread *);
+static void reap_dead (void *aux);
 static void schedule (void);
 void schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
@@ -87,10 +173,21 @@ static tid_t allocate_tid (void);
 void
 thread_init (void) 
 {
+  int i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
-  lock_init (&tid_lock);
-  list_init (&ready_list);
+  lock_init_named (&tid_lock, "tid");
+  list_init (&all_list);
+  list_init (&reap_list);
+  work_init (&reap_work, reap_dead, NULL, PRI_MAX);
+  for (i = 0; i < PRI_CNT; i++)
+    list_init (&ready_queues[i]);
+  ready_levels = 0;
+  ready_cnt = 0;
+  list_init (&mlfqs_active);
+  list_init (&mlfqs_dirty);
+  load_avg = 0;
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
@@ -111,6 +208,17 @@ thread_start (void)
   sema_init (&idle_started, 0);
   thread_create ("idle", PRI_MIN, idle, &idle_started);
 
+  /* Interrupts are still off, so the tick count is 0 and the
+     recalculation falls on multiples of MLFQS_PRI_TICKS, and the
+     per-second update on multiples of TIMER_FREQ. */
+  if (thread_mlfqs) 
+    {
+      callout_init (&mlfqs_callout, mlfqs_recalculate, NULL, CALLOUT_IRQ);
+      timer_schedule_periodic (&mlfqs_callout, MLFQS_PRI_TICKS);
+      callout_init (&mlfqs_second_callout, mlfqs_second, NULL, CALLOUT_IRQ);
+      timer_schedule_periodic (&mlfqs_second_callout, TIMER_FREQ);
+    }
+
   /* Start preemptive thread scheduling. */
   intr_enable ();
 
@@ -134,18 +242,81 @@ thread_tick (void)
 #endif
   else
     kernel_ticks++;
+  if (t != idle_thread)
+    t->run_ticks++;
+
+  /* Charge the tick to T's recent_cpu. */
+  if (thread_mlfqs && t != idle_thread) 
+    {
+      t->recent_cpu = fp_add_int (t->recent_cpu, 1);
+      mlfqs_mark_active (t);
+      mlfqs_mark_dirty (t);
+    }
 
   /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
-    intr_yield_on_return ();
+  if (++thread_ticks >= t->slice) 
+    {
+      if (thread_adaptive_slice && t != idle_thread)
+        adapt_slice (t, true);
+      intr_yield_on_return ();
+    }
 }
 
-/* Prints thread statistics. */
+/* Prints thread statistics: global tick counts, then per-thread
+   counts for each live thread, then the nonempty buckets of the
+   wakeup-to-run latency histogram. */
 void
 thread_print_stats (void) 
 {
+  struct list_elem *e;
+  int i;
+
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+  printf ("Thread: %lld context switches, %lld per second\n", switch_cnt,
+          switch_cnt * TIMER_FREQ / (timer_ticks () > 0 ? timer_ticks () : 1));
+
+  for (e = list_begin (&all_list); e != list_end (&all_list);
+       e = list_next (e)) 
+    {
+      struct thread *t = list_entry (e, struct thread, allelem);
+      if (t != idle_thread)
+        printf ("Thread %d (%s): %lld running ticks, %lld us ready, "
+                "%u voluntary and %u involuntary switches\n",
+                t->tid, t->name, t->run_ticks, t->ready_ns / 1000,
+                t->voluntary_switches, t->involuntary_switches);
+    }
+
+  printf ("Thread: wakeup-to-run latency in us:");
+  for (i = 0; i < LATENCY_BUCKETS; i++)
+    if (latency_hist[i] != 0) 
+      {
+        if (i == 0)
+          printf (" <1:%u", latency_hist[i]);
+        else if (i == LATENCY_BUCKETS - 1)
+          printf (" >=%lld:%u", 1LL << (i - 1), latency_hist[i]);
+        else
+          printf (" %lld-%lld:%u", 1LL << (i - 1), (1LL << i) - 1,
+                  latency_hist[i]);
+      }
+  printf ("\n");
+}
+
+/* Copies up to CNT buckets of the wakeup-to-run latency
+   histogram into COUNTS, which must be kernel memory because it
+   is written with interrupts off, and returns the total number
+   of buckets, LATENCY_BUCKETS. */
+int
+thread_latency_histogram (unsigned counts[], int cnt) 
+{
+  enum intr_level old_level = intr_disable ();
+  int i;
+
+  for (i = 0; i < cnt && i < LATENCY_BUCKETS; i++)
+    counts[i] = latency_hist[i];
+  intr_set_level (old_level);
+
+  return LATENCY_BUCKETS;
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -160,9 +331,7 @@ thread_print_stats (void)
    scheduled.  Use a semaphore or some other form of
    synchronization if you need to ensure ordering.
 
-   The code provided sets the new thread's `priority' member to
-   PRIORITY, but no actual priority scheduling is implemented.
-   Priority scheduling is the goal of Problem 1-3. */
+   The new thread is queued on the run queue for PRIORITY. */
 tid_t
 thread_create (const char *name, int priority,
                thread_func *function, void *aux) 
@@ -176,13 +345,19 @@ thread_create (const char *name, int priority,
   ASSERT (function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  t = alloc_thread_page ();
   if (t == NULL)
     return TID_ERROR;
 
   /* Initialize thread. */
   init_thread (t, name, priority);
   tid = t->tid = allocate_tid ();
+  if (thread_mlfqs) 
+    {
+      enum intr_level old_level = intr_disable ();
+      mlfqs_mark_active (t);
+      intr_set_level (old_level);
+    }
 
   /* Stack frame for kernel_thread(). */
   kf = alloc_frame (t, sizeof *kf);
@@ -198,12 +373,14 @@ thread_create (const char *name, int priority,
   sf = alloc_frame (t, sizeof *sf);
   sf->eip = switch_entry;
 
-  thread_unblock (t);
-
   /* Project2 : Add parent thread to child */
   t->parent_t = thread_current();
   t->current_dir_sec = thread_current()->current_dir_sec;
 
+  /* Add to run queue, and run it now if it outranks us. */
+  thread_unblock (t);
+  thread_preempt ();
+
   return tid;
 }
 
@@ -216,10 +393,15 @@ thread_create (const char *name, int priority,
 void
 thread_block (void) 
 {
+  struct thread *curr = thread_current ();
+
   ASSERT (!intr_context ());
   ASSERT (intr_get_level () == INTR_OFF);
 
-  thread_current ()->status = THREAD_BLOCKED;
+  if (thread_adaptive_slice && curr != idle_thread
+      && thread_ticks < curr->slice)
+    adapt_slice (curr, false);
+  curr->status = THREAD_BLOCKED;
   schedule ();
 }
 
@@ -230,7 +412,8 @@ thread_block (void)
    This function does not preempt the running thread.  This can
    be important: if the caller had disabled interrupts itself,
    it may expect that it can atomically unblock a thread and
-   update other data. */
+   update other data.  Call thread_preempt() afterward to give
+   the CPU to T if it has a higher priority. */
 void
 thread_unblock (struct thread *t) 
 {
@@ -240,11 +423,63 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_push_back (&ready_list, &t->elem);
+  ready_queue_push (t);
   t->status = THREAD_READY;
+  t->ready_since = timer_ns ();
+  t->woken = true;
   intr_set_level (old_level);
 }
 
+/* Transitions every thread on THREADS, all of which must be
+   blocked, to the ready-to-run state, leaving THREADS empty.
+   Consecutive threads of equal priority are moved onto their run
+   queue with a single list splice.  Afterward, yields once, or
+   from an interrupt handler requests one yield on return, if any
+   of the threads outranks the running thread.  Interrupts must be
+   off. */
+void
+thread_unblock_all (struct list *threads) 
+{
+  int64_t now;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (list_empty (threads))
+    return;
+
+  now = timer_ns ();
+  while (!list_empty (threads)) 
+    {
+      struct list_elem *first = list_begin (threads);
+      struct list_elem *last = first;
+      int priority = list_entry (first, struct thread, elem)->priority;
+      int cnt = 0;
+
+      for (;;) 
+        {
+          struct thread *t = list_entry (last, struct thread, elem);
+
+          ASSERT (is_thread (t));
+          ASSERT (t->status == THREAD_BLOCKED);
+          if (t->priority != priority)
+            break;
+          t->status = THREAD_READY;
+          t->ready_since = now;
+          t->woken = true;
+          cnt++;
+          last = list_next (last);
+          if (last == list_end (threads))
+            break;
+        }
+
+      ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+      list_splice (list_end (&ready_queues[priority - PRI_MIN]), first, last);
+      ready_levels |= (uint64_t) 1 << (priority - PRI_MIN);
+      ready_cnt += cnt;
+    }
+  thread_preempt ();
+}
+
 /* Returns the name of the running thread. */
 const char *
 thread_name (void) 
@@ -292,6 +527,11 @@ thread_exit (void)
   /* Just set our status to dying and schedule another process.
      We will be destroyed during the call to schedule_tail(). */
   intr_disable ();
+  list_remove (&thread_current ()->allelem);
+  if (thread_current ()->mlfqs_active)
+    list_remove (&thread_current ()->mlfqs_elem);
+  if (thread_current ()->mlfqs_dirty)
+    list_remove (&thread_current ()->dirty_elem);
   thread_current ()->status = THREAD_DYING;
   schedule ();
   NOT_REACHED ();
@@ -301,25 +541,82 @@ thread_exit (void)
    may be scheduled again immediately at the scheduler's whim. */
 void
 thread_yield (void) 
+{
+  yield (false);
+}
+
+/* Yields the CPU because the running thread has been preempted,
+   by the end of its time slice or by a higher-priority thread,
+   rather than by its own choice.  Otherwise like thread_yield(). */
+void
+thread_yield_preempted (void) 
+{
+  yield (true);
+}
+
+/* Yields the CPU if a ready thread has a higher priority than
+   the running thread.  Within an external interrupt handler,
+   arranges to yield just before the interrupt returns. */
+void
+thread_preempt (void) 
+{
+  enum intr_level old_level = intr_disable ();
+
+  if (ready_queue_max_priority () > thread_current ()->priority) 
+    {
+      if (intr_context ())
+        intr_yield_on_return ();
+      else
+        thread_yield_preempted ();
+    }
+  intr_set_level (old_level);
+}
+
+/* Sets the current thread's base priority to NEW_PRIORITY.  The
+   thread keeps any higher priority donated to it through locks
+   that it holds.  Ignored when the MLFQS is in use, since it
+   computes priorities itself. */
+void
+thread_set_priority (int new_priority) 
 {
   struct thread *curr = thread_current ();
   enum intr_level old_level;
-  
-  ASSERT (!intr_context ());
+
+  ASSERT (PRI_MIN <= new_priority && new_priority <= PRI_MAX);
+
+  if (thread_mlfqs)
+    return;
 
   old_level = intr_disable ();
-  if (curr != idle_thread) 
-    list_push_back (&ready_list, &curr->elem);
-  curr->status = THREAD_READY;
-  schedule ();
+  curr->base_priority = new_priority;
+  thread_update_priority (curr);
+  thread_preempt ();
   intr_set_level (old_level);
 }
 
-/* Sets the current thread's priority to NEW_PRIORITY. */
+/* Recomputes T's effective priority as the higher of its base
+   priority, plus any adaptive time slice bonus, and the highest
+   priority of any thread waiting on a lock that T holds.
+   Interrupts must be off. */
 void
-thread_set_priority (int new_priority) 
+thread_update_priority (struct thread *t) 
 {
-  thread_current ()->priority = new_priority;
+  int priority = t->base_priority + t->slice_bonus;
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (priority > PRI_MAX)
+    priority = PRI_MAX;
+
+  for (e = list_begin (&t->held_locks); e != list_end (&t->held_locks);
+       e = list_next (e)) 
+    {
+      struct lock *lock = list_entry (e, struct lock, elem);
+      if (lock->max_priority > priority)
+        priority = lock->max_priority;
+    }
+  change_priority (t, priority);
 }
 
 /* Returns the current thread's priority. */
@@ -329,35 +626,152 @@ thread_get_priority (void)
   return thread_current ()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Sets the current thread's nice value to NICE, recalculates
+   its priority, and yields if it no longer has the highest
+   priority. */
 void
-thread_set_nice (int nice UNUSED) 
+thread_set_nice (int nice) 
 {
-  /* Not yet implemented. */
+  struct thread *curr = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (NICE_MIN <= nice && nice <= NICE_MAX);
+
+  old_level = intr_disable ();
+  curr->nice = nice;
+  if (thread_mlfqs) 
+    {
+      mlfqs_mark_active (curr);
+      change_priority (curr, mlfqs_priority (curr));
+      thread_preempt ();
+    }
+  intr_set_level (old_level);
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int load_avg_100 = fp_round (fp_mul_int (load_avg, 100));
+  intr_set_level (old_level);
+
+  return load_avg_100;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int recent_cpu_100 = fp_round (fp_mul_int (thread_current ()->recent_cpu,
+                                             100));
+  intr_set_level (old_level);
+
+  return recent_cpu_100;
+}
+
+/* Timer callout run once per second, in the timer interrupt.
+   Updates load_avg and the recent_cpu of every thread on
+   mlfqs_active, then recalculates their priorities at once, in
+   case mlfqs_recalculate() already ran on this tick. */
+static void
+mlfqs_second (void *aux UNUSED) 
+{
+  struct thread *t = thread_current ();
+  int ready_threads = ready_cnt + (t != idle_thread);
+  fixed_t twice_load;
+  fixed_t decay;
+  struct list_elem *e, *next;
+
+  load_avg = fp_add (fp_div_int (fp_mul_int (load_avg, 59), 60),
+                     fp_div_int (fp_from_int (ready_threads), 60));
+  twice_load = fp_mul_int (load_avg, 2);
+  decay = fp_div (twice_load, fp_add_int (twice_load, 1));
+
+  for (e = list_begin (&mlfqs_active); e != list_end (&mlfqs_active);
+       e = next) 
+    {
+      struct thread *a = list_entry (e, struct thread, mlfqs_elem);
+
+      next = list_next (e);
+      a->recent_cpu = fp_add_int (fp_mul (decay, a->recent_cpu), a->nice);
+      mlfqs_mark_dirty (a);
+      if (a->recent_cpu == 0 && a->nice == 0) 
+        {
+          list_remove (&a->mlfqs_elem);
+          a->mlfqs_active = false;
+        }
+    }
+
+  mlfqs_recalculate (NULL);
+}
+
+/* Timer callout run every MLFQS_PRI_TICKS ticks, in the timer
+   interrupt.  Recalculates the priorities of threads whose
+   recent_cpu has changed. */
+static void
+mlfqs_recalculate (void *aux UNUSED) 
+{
+  while (!list_empty (&mlfqs_dirty)) 
+    {
+      struct list_elem *e = list_pop_front (&mlfqs_dirty);
+      struct thread *d = list_entry (e, struct thread, dirty_elem);
+
+      d->mlfqs_dirty = false;
+      change_priority (d, mlfqs_priority (d));
+    }
+  thread_preempt ();
+}
+
+/* Puts T on mlfqs_active if its recent_cpu or nice is nonzero
+   and it is not there already.  Interrupts must be off. */
+static void
+mlfqs_mark_active (struct thread *t) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!t->mlfqs_active && (t->recent_cpu != 0 || t->nice != 0)) 
+    {
+      list_push_back (&mlfqs_active, &t->mlfqs_elem);
+      t->mlfqs_active = true;
+    }
+}
+
+/* Puts T on mlfqs_dirty, if it is not there already.
+   Interrupts must be off. */
+static void
+mlfqs_mark_dirty (struct thread *t) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!t->mlfqs_dirty) 
+    {
+      list_push_back (&mlfqs_dirty, &t->dirty_elem);
+      t->mlfqs_dirty = true;
+    }
+}
+
+/* Returns the MLFQS priority for T, based on its recent_cpu and
+   nice values. */
+static int
+mlfqs_priority (const struct thread *t) 
+{
+  int priority = PRI_MAX - fp_to_int (fp_div_int (t->recent_cpu, 4))
+                 - t->nice * 2;
+
+  if (priority < PRI_MIN)
+    priority = PRI_MIN;
+  else if (priority > PRI_MAX)
+    priority = PRI_MAX;
+  return priority;
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -382,6 +796,10 @@ idle (void *idle_started_ UNUSED)
       intr_disable ();
       thread_block ();
 
+      /* Stop the periodic tick until the next sleeper is due, if
+         tickless mode is enabled. */
+      timer_enter_idle ();
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -435,6 +853,8 @@ is_thread (struct thread *t)
 static void
 init_thread (struct thread *t, const char *name, int priority)
 {
+  enum intr_level old_level;
+
   ASSERT (t != NULL);
   ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
   ASSERT (name != NULL);
@@ -443,15 +863,36 @@ init_thread (struct thread *t, const char *name, int priority)
   t->status = THREAD_BLOCKED;
   strlcpy (t->name, name, sizeof t->name);
   t->stack = (uint8_t *) t + PGSIZE;
-  t->priority = priority;
+  t->priority = t->base_priority = priority;
+  t->slice = thread_time_slice;
+  t->detached = true;
+  list_init (&t->held_locks);
+  t->waiting_lock = NULL;
+  t->waiting_sema = NULL;
+  t->waiting_cond = NULL;
+  t->nice = NICE_DEFAULT;
+  t->recent_cpu = 0;
   t->magic = THREAD_MAGIC;
 
+  old_level = intr_disable ();
+  list_push_back (&all_list, &t->allelem);
+  intr_set_level (old_level);
+
+  /* Under the MLFQS, a new thread inherits its creator's nice
+     and recent_cpu values, which then determine its priority. */
+  if (thread_mlfqs && t != initial_thread) 
+    {
+      struct thread *parent = thread_current ();
+      t->nice = parent->nice;
+      t->recent_cpu = parent->recent_cpu;
+      t->priority = mlfqs_priority (t);
+    }
+
   /* Project2 : Initialize thread structure */
 #ifdef USERPROG
   list_init(&t->child_list);
   list_init (&t->file_list);
-  sema_init(&t->c_sema, 0);
-  sema_init(&t->p_sema, 0);
+  completion_init (&t->exited);
   sema_init(&t->success_load, 0);
   t->success_b = false;
   t->max_fd = 2;
@@ -469,9 +910,88 @@ alloc_frame (struct thread *t, size_t size)
   ASSERT (size % sizeof (uint32_t) == 0);
 
   t->stack -= size;
+  memset (t->stack, 0, size);
   return t->stack;
 }
 
+/* Returns a page for a new thread, from the page cache if it is
+   not empty, otherwise from the kernel pool.  The page is not
+   zeroed.  Returns a null pointer if no page is available. */
+static struct thread *
+alloc_thread_page (void) 
+{
+  enum intr_level old_level = intr_disable ();
+  void *page = page_cache_cnt > 0 ? page_cache[--page_cache_cnt] : NULL;
+  intr_set_level (old_level);
+
+  return page != NULL ? page : palloc_get_page (0);
+}
+
+/* Frees the page of dead thread T, keeping it in the page cache
+   if there is room. */
+static void
+free_thread_page (struct thread *t) 
+{
+  enum intr_level old_level = intr_disable ();
+  bool cached = page_cache_cnt < PAGE_CACHE_SIZE;
+
+  if (cached)
+    page_cache[page_cache_cnt++] = t;
+  intr_set_level (old_level);
+
+  if (!cached)
+    palloc_free_page (t);
+}
+
+/* Marks thread T, which was created detached or is a zombie, as
+   detached: no one will examine its struct thread after it has
+   exited.  If T has already exited, its page is freed; otherwise,
+   it will be freed when T exits. */
+void
+thread_detach (struct thread *t) 
+{
+  enum intr_level old_level;
+
+  ASSERT (is_thread (t));
+
+  old_level = intr_disable ();
+  ASSERT (!t->detached);
+  t->detached = true;
+  if (t->zombie)
+    reap (t);
+  intr_set_level (old_level);
+}
+
+/* Hands dead thread T to the system work queue to have its page
+   freed.  Interrupts must be off. */
+static void
+reap (struct thread *t) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_push_back (&reap_list, &t->elem);
+  work_submit (&system_wq, &reap_work);
+}
+
+/* Frees the pages of dead threads, taking all of the threads on
+   reap_list at once. */
+static void
+reap_dead (void *aux UNUSED) 
+{
+  struct list dead;
+  enum intr_level old_level;
+
+  list_init (&dead);
+  old_level = intr_disable ();
+  list_splice (list_end (&dead),
+               list_begin (&reap_list), list_end (&reap_list));
+  intr_set_level (old_level);
+
+  while (!list_empty (&dead))
+    free_thread_page (list_entry (list_pop_front (&dead),
+                                  struct thread, elem));
+}
+
 /* Chooses and returns the next thread to be scheduled.  Should
    return a thread from the run queue, unless the run queue is
    empty.  (If the running thread can continue running, then it
@@ -480,10 +1000,89 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void) 
 {
-  if (list_empty (&ready_list))
+  int priority = ready_queue_max_priority ();
+  struct list *queue;
+  struct thread *t;
+
+  if (priority < PRI_MIN)
     return idle_thread;
+
+  queue = &ready_queues[priority - PRI_MIN];
+  t = list_entry (list_pop_front (queue), struct thread, elem);
+  if (list_empty (queue))
+    ready_levels &= ~((uint64_t) 1 << (priority - PRI_MIN));
+  ready_cnt--;
+  return t;
+}
+
+/* Adds T to the tail of the run queue for its priority.
+   Interrupts must be off. */
+static void
+ready_queue_push (struct thread *t) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+  list_push_back (&ready_queues[t->priority - PRI_MIN], &t->elem);
+  ready_levels |= (uint64_t) 1 << (t->priority - PRI_MIN);
+  ready_cnt++;
+}
+
+/* Removes ready thread T from its run queue.
+   Interrupts must be off. */
+static void
+ready_queue_remove (struct thread *t) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status == THREAD_READY);
+
+  list_remove (&t->elem);
+  if (list_empty (&ready_queues[t->priority - PRI_MIN]))
+    ready_levels &= ~((uint64_t) 1 << (t->priority - PRI_MIN));
+  ready_cnt--;
+}
+
+/* Returns the priority of the highest-priority ready thread, or
+   PRI_MIN - 1 if no thread is ready.  Interrupts must be off. */
+static int
+ready_queue_max_priority (void) 
+{
+  uint32_t high = ready_levels >> 32;
+  uint32_t low = ready_levels;
+
+  /* __builtin_clz() compiles to a single `bsr' instruction.
+     See [IA32-v2a] "BSR--Bit Scan Reverse". */
+  if (high != 0)
+    return PRI_MIN + 63 - __builtin_clz (high);
+  else if (low != 0)
+    return PRI_MIN + 31 - __builtin_clz (low);
   else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+    return PRI_MIN - 1;
+}
+
+/* Sets T's priority to PRIORITY, moving T to the run queue for
+   its new priority if it is ready, or to its new place among the
+   waiters of the semaphore or condition variable that it is
+   blocked on.  Interrupts must be off. */
+static void
+change_priority (struct thread *t, int priority) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+  if (t->priority == priority)
+    return;
+  if (t->status == THREAD_READY && t != idle_thread) 
+    {
+      ready_queue_remove (t);
+      t->priority = priority;
+      ready_queue_push (t);
+    }
+  else 
+    {
+      t->priority = priority;
+      synch_requeue (t);
+    }
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -520,15 +1119,19 @@ schedule_tail (struct thread *prev)
   process_activate ();
 #endif
 
-  /* If the thread we switched from is dying, destroy its struct
-     thread.  This must happen late so that thread_exit() doesn't
-     pull out the rug under itself.  (We don't free
+  /* If the thread we switched from is dying, have its struct
+     thread destroyed by reap_work, or keep it as a zombie until
+     it is detached.  This must happen late so that thread_exit()
+     doesn't pull out the rug under itself.  (We don't free
      initial_thread because its memory was not obtained via
      palloc().) */
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) 
     {
       ASSERT (prev != curr);
-      palloc_free_page (prev);
+      if (prev->detached)
+        reap (prev);
+      else
+        prev->zombie = true;
     }
 }
 
@@ -550,11 +1153,98 @@ schedule (void)
   ASSERT (curr->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
-  if (curr != next)
-    prev = switch_threads (curr, next);
+  if (curr != next) 
+    {
+      switch_cnt++;
+      account_switch (curr, next);
+      prev = switch_threads (curr, next);
+    }
   schedule_tail (prev); 
 }
 
+/* Yields the CPU, counting it as an involuntary switch if
+   PREEMPTED is true. */
+static void
+yield (bool preempted) 
+{
+  struct thread *curr = thread_current ();
+  enum intr_level old_level;
+  
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  if (curr != idle_thread) 
+    ready_queue_push (curr);
+  curr->status = THREAD_READY;
+  curr->ready_since = timer_ns ();
+  curr->woken = false;
+  yield_preempted = preempted;
+  schedule ();
+  intr_set_level (old_level);
+}
+
+/* Adjusts T's time slice and priority bonus after T used up its
+   time slice, if EXPIRED is true, or blocked before the end of it,
+   if EXPIRED is false.  Interrupts must be off. */
+static void
+adapt_slice (struct thread *t, bool expired) 
+{
+  int bonus = t->slice_bonus;
+  int cap = thread_time_slice * SLICE_GROWTH;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (expired) 
+    {
+      t->slice = t->slice * 2 > cap ? cap : t->slice * 2;
+      bonus = 0;
+    }
+  else 
+    {
+      if (t->slice > 1)
+        t->slice /= 2;
+      if (bonus < SLICE_BONUS_MAX && t->base_priority + bonus < PRI_MAX)
+        bonus++;
+    }
+
+  if (!thread_mlfqs && bonus != t->slice_bonus) 
+    {
+      t->slice_bonus = bonus;
+      thread_update_priority (t);
+    }
+}
+
+/* Updates statistics for a switch from PREV, which has just
+   stopped running, to NEXT.  Interrupts must be off. */
+static void
+account_switch (struct thread *prev, struct thread *next) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (prev != idle_thread && prev->status != THREAD_DYING) 
+    {
+      if (prev->status == THREAD_READY && yield_preempted)
+        prev->involuntary_switches++;
+      else
+        prev->voluntary_switches++;
+    }
+
+  if (next != idle_thread) 
+    {
+      int64_t wait = timer_ns () - next->ready_since;
+
+      next->ready_ns += wait;
+      if (next->woken) 
+        {
+          int64_t wait_us = wait / 1000;
+          int bucket = 0;
+          while (bucket < LATENCY_BUCKETS - 1 && wait_us >= 1LL << bucket)
+            bucket++;
+          latency_hist[bucket]++;
+        }
+    }
+}
+
 /* Returns a tid to use for a new thread. */
 static tid_t
 allocate_tid (void) 
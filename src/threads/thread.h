@@ -4,6 +4,8 @@
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
+#include "devices/timer.h"
+#include "threads/fixed-point.h"
 #include "threads/synch.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
@@ -28,6 +30,11 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Thread niceness, for the multi-level feedback queue scheduler. */
+#define NICE_MIN -20                    /* Least nice (highest priority). */
+#define NICE_DEFAULT 0                  /* Default niceness. */
+#define NICE_MAX 20                     /* Nicest (lowest priority). */
+
 /* A kernel thread or user process.
 
    Each thread structure is stored in its own 4 kB page.  The
@@ -103,18 +110,45 @@ struct thread
     enum thread_status status;          /* Thread state. */
     char name[16];                      /* Name (for debugging purposes). */
     uint8_t *stack;                     /* Saved stack pointer. */
-    int priority;                       /* Priority. */
+    int priority;                       /* Effective priority. */
+    int base_priority;                  /* Priority before donation. */
+    struct list_elem allelem;           /* List element for all threads list. */
+    bool detached;                      /* Free page as soon as it exits? */
+    bool zombie;                        /* Exited, awaiting thread_detach()? */
+
+    /* Owned by thread.c, for scheduler statistics. */
+    int64_t run_ticks;                  /* Timer ticks spent running. */
+    int64_t ready_ns;                   /* Nanoseconds spent ready. */
+    int64_t ready_since;                /* timer_ns() when last made ready. */
+    bool woken;                         /* Unblocked, not preempted? */
+    unsigned voluntary_switches;        /* # of times blocked or yielded. */
+    unsigned involuntary_switches;      /* # of times preempted. */
+
+    /* Owned by thread.c, for adaptive time slices. */
+    int slice;                          /* Time slice, in timer ticks. */
+    int slice_bonus;                    /* Priority bonus for blocking early. */
+
+    /* Owned by thread.c, used only by the MLFQS. */
+    int nice;                           /* Niceness. */
+    fixed_t recent_cpu;                 /* Recently received CPU time. */
+    struct list_elem mlfqs_elem;        /* Element in mlfqs_active. */
+    bool mlfqs_active;                  /* On mlfqs_active? */
+    struct list_elem dirty_elem;        /* Element in mlfqs_dirty. */
+    bool mlfqs_dirty;                   /* On mlfqs_dirty? */
 
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
+    struct list held_locks;             /* Locks held, for donation. */
+    struct lock *waiting_lock;          /* Lock being waited for. */
+    struct semaphore *waiting_sema;     /* Semaphore being waited for. */
+    struct condition *waiting_cond;     /* Condition being waited for. */
 
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
 #endif
     /* Project1 : Alarm Clock */
-    struct list_elem wakeup_elem;
-    int64_t wakeup_time;
+    struct callout sleep_callout;       /* Ends timer_sleep(). */
     
     /* Project2 : Structure using in Userprog */
     struct list file_list;              /* Each thread has file list */
@@ -125,8 +159,7 @@ struct thread
     int exit_status;                    /* Save exit_status */
     bool wait;                          /* true if parent already call wait */
     bool success_b;                     /* When child thread create, save it is success to load */
-    struct semaphore c_sema;            /* sema for wait */
-    struct semaphore p_sema;            /* sema for delete child thread */
+    struct completion exited;           /* Completed on exit, for wait */
     struct list_elem c_elem;            /* List element */
     struct thread *parent_t;            /* parent thread */
     struct file* own_file;              /* Save thread's file */
@@ -145,27 +178,47 @@ struct thread
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* Default time slice, in timer ticks.
+   Controlled by kernel command-line option "-ts=TICKS". */
+extern int thread_time_slice;
+
+/* If true, adapt each thread's time slice to its behavior.
+   Controlled by kernel command-line option "-adaptive-ts". */
+extern bool thread_adaptive_slice;
+
+/* Number of buckets in the wakeup-to-run latency histogram.
+   Bucket 0 counts latencies under 1 us, bucket B > 0 counts
+   latencies of 2**(B-1) up to 2**B us, and the last bucket also
+   counts everything longer. */
+#define LATENCY_BUCKETS 24
+
 void thread_init (void);
 void thread_start (void);
 
 void thread_tick (void);
 void thread_print_stats (void);
+int thread_latency_histogram (unsigned counts[], int cnt);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
 
 void thread_block (void);
 void thread_unblock (struct thread *);
+void thread_unblock_all (struct list *);
 
 struct thread *thread_current (void);
 tid_t thread_tid (void);
 const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
+void thread_detach (struct thread *);
 void thread_yield (void);
+void thread_yield_preempted (void);
+void thread_preempt (void);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
+void thread_update_priority (struct thread *);
 
 int thread_get_nice (void);
 void thread_set_nice (int);
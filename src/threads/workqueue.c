@@ -0,0 +1,254 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+
+/* Number of worker threads in system_wq. */
+#define SYSTEM_WQ_WORKERS 2
+
+/* Queue shared by the whole kernel. */
+struct workqueue system_wq;
+
+/* A worker thread that is running a work item.  Lives on the
+   worker's stack while it is on its workqueue's busy list. */
+struct worker
+  {
+    struct list_elem elem;      /* Element in workqueue's busy list. */
+    struct thread *thread;      /* The worker thread. */
+    int priority;               /* Priority it is running at. */
+  };
+
+static void worker (void *wq_);
+static void boost_workers (struct workqueue *, int priority);
+static bool work_more_priority (const struct list_elem *,
+                                const struct list_elem *, void *aux);
+
+/* Starts the system work queue.  Must be called after
+   thread_start(). */
+void
+workqueue_start (void) 
+{
+  workqueue_init (&system_wq, "events", SYSTEM_WQ_WORKERS, PRI_DEFAULT);
+}
+
+/* Initializes WQ and starts WORKERS worker threads for it, named
+   after NAME, which wait for work at PRIORITY.  Each item runs at
+   its own priority, however, except under the multi-level
+   feedback queue scheduler, where thread_set_priority() has no
+   effect and items run at whatever priority the scheduler gives
+   the worker. */
+void
+workqueue_init (struct workqueue *wq, const char *name,
+                int workers, int priority) 
+{
+  int i;
+
+  ASSERT (wq != NULL);
+  ASSERT (workers > 0);
+
+  list_init (&wq->pending);
+  list_init (&wq->idle);
+  list_init (&wq->flushers);
+  list_init (&wq->busy);
+  wq->running = 0;
+  wq->priority = priority;
+
+  for (i = 0; i < workers; i++) 
+    {
+      char thread_name[16];
+
+      snprintf (thread_name, sizeof thread_name, "%s/%d", name, i);
+      if (thread_create (thread_name, priority, worker, wq) == TID_ERROR)
+        PANIC ("%s: cannot create worker thread", thread_name);
+    }
+}
+
+/* Initializes WORK to call FUNC with AUX, at PRIORITY, once
+   submitted. */
+void
+work_init (struct work *work, work_func *func, void *aux, int priority) 
+{
+  ASSERT (work != NULL);
+  ASSERT (func != NULL);
+  ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+  work->func = func;
+  work->aux = aux;
+  work->priority = priority;
+  work->pending = false;
+}
+
+/* Submits WORK to WQ and returns true, or returns false if WORK
+   is already pending.  WORK may be submitted again as soon as it
+   has started running, even by its own function.
+
+   If no worker is idle, the busy workers running at a lower
+   priority than WORK are raised to WORK's priority until they
+   finish their current items, so that WORK does not wait behind
+   a low-priority item that other threads keep off the CPU.
+
+   This function may be called from an interrupt handler. */
+bool
+work_submit (struct workqueue *wq, struct work *work) 
+{
+  enum intr_level old_level;
+  bool submitted = false;
+
+  ASSERT (wq != NULL);
+  ASSERT (work != NULL);
+
+  old_level = intr_disable ();
+  if (!work->pending) 
+    {
+      work->pending = true;
+      list_insert_ordered (&wq->pending, &work->elem,
+                           work_more_priority, NULL);
+      if (!list_empty (&wq->idle))
+        thread_unblock (list_entry (list_pop_front (&wq->idle),
+                                    struct thread, elem));
+      else
+        boost_workers (wq, work->priority);
+      submitted = true;
+    }
+  intr_set_level (old_level);
+
+  return submitted;
+}
+
+/* Removes WORK from WQ and returns true if it is pending, or
+   returns false if it is not, in which case it may be running.
+
+   This function may be called from an interrupt handler. */
+bool
+work_cancel (struct workqueue *wq UNUSED, struct work *work) 
+{
+  enum intr_level old_level;
+  bool canceled = false;
+
+  ASSERT (work != NULL);
+
+  old_level = intr_disable ();
+  if (work->pending) 
+    {
+      work->pending = false;
+      list_remove (&work->elem);
+      canceled = true;
+    }
+  intr_set_level (old_level);
+
+  return canceled;
+}
+
+/* Waits until WQ has no pending or running work.  Work submitted
+   meanwhile is waited for too, so this may not return while other
+   threads keep WQ busy. */
+void
+workqueue_flush (struct workqueue *wq) 
+{
+  enum intr_level old_level;
+
+  ASSERT (wq != NULL);
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  while (!list_empty (&wq->pending) || wq->running > 0) 
+    {
+      list_push_back (&wq->flushers, &thread_current ()->elem);
+      thread_block ();
+    }
+  intr_set_level (old_level);
+}
+
+/* Worker thread for work queue WQ_.  Runs pending items one at a
+   time, each at its own priority (ignored with -mlfqs). */
+static void
+worker (void *wq_) 
+{
+  struct workqueue *wq = wq_;
+  struct worker self;
+
+  self.thread = thread_current ();
+  intr_disable ();
+  for (;;) 
+    {
+      struct work *work;
+      work_func *func;
+      void *aux;
+      int priority;
+
+      if (list_empty (&wq->pending)) 
+        {
+          list_push_back (&wq->idle, &thread_current ()->elem);
+          thread_block ();
+          continue;
+        }
+
+      work = list_entry (list_pop_front (&wq->pending), struct work, elem);
+      work->pending = false;
+      func = work->func;
+      aux = work->aux;
+      priority = work->priority;
+      wq->running++;
+
+      /* Join the busy list and take on PRIORITY without turning
+         interrupts on in between, so that no boost is missed or
+         undone. */
+      self.priority = priority;
+      list_push_back (&wq->busy, &self.elem);
+      thread_set_priority (priority);
+      intr_enable ();
+
+      /* WORK may be freed or resubmitted once FUNC starts, so we
+         do not touch it again. */
+      func (aux);
+
+      intr_disable ();
+      list_remove (&self.elem);
+      thread_set_priority (wq->priority);
+      wq->running--;
+      if (list_empty (&wq->pending) && wq->running == 0)
+        while (!list_empty (&wq->flushers))
+          thread_unblock (list_entry (list_pop_front (&wq->flushers),
+                                      struct thread, elem));
+    }
+}
+
+/* Raises each of WQ's busy workers that is running below
+   PRIORITY to PRIORITY, until it finishes its current item.  Has
+   no effect under the MLFQS.  Interrupts must be off. */
+static void
+boost_workers (struct workqueue *wq, int priority) 
+{
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (thread_mlfqs)
+    return;
+
+  for (e = list_begin (&wq->busy); e != list_end (&wq->busy);
+       e = list_next (e)) 
+    {
+      struct worker *w = list_entry (e, struct worker, elem);
+
+      if (w->priority < priority) 
+        {
+          w->priority = priority;
+          w->thread->base_priority = priority;
+          thread_update_priority (w->thread);
+        }
+    }
+}
+
+/* Returns true if work A has higher priority than work B, false
+   otherwise. */
+static bool
+work_more_priority (const struct list_elem *a_, const struct list_elem *b_,
+                    void *aux UNUSED) 
+{
+  const struct work *a = list_entry (a_, struct work, elem);
+  const struct work *b = list_entry (b_, struct work, elem);
+
+  return a->priority > b->priority;
+}
@@ -0,0 +1,46 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+
+/* Function that performs a work item. */
+typedef void work_func (void *aux);
+
+/* A work item: a function call to be made later by one of a work
+   queue's worker threads.  The caller owns the storage, which
+   must remain valid until the item has run or been canceled. */
+struct work
+  {
+    struct list_elem elem;      /* Element in workqueue's pending list. */
+    work_func *func;            /* Function to call. */
+    void *aux;                  /* Argument to FUNC. */
+    int priority;               /* Priority to run FUNC at. */
+    bool pending;               /* Submitted but not yet started? */
+  };
+
+/* A work queue: a fixed pool of worker threads that run submitted
+   work items, highest priority first. */
+struct workqueue
+  {
+    struct list pending;        /* Submitted items, highest priority first. */
+    struct list idle;           /* Workers waiting for work. */
+    struct list flushers;       /* Threads in workqueue_flush(). */
+    struct list busy;           /* Workers running an item. */
+    int running;                /* Number of items being run. */
+    int priority;               /* Priority of idle workers. */
+  };
+
+/* Queue shared by the whole kernel. */
+extern struct workqueue system_wq;
+
+void workqueue_start (void);
+void workqueue_init (struct workqueue *, const char *name,
+                     int workers, int priority);
+
+void work_init (struct work *, work_func *, void *aux, int priority);
+bool work_submit (struct workqueue *, struct work *);
+bool work_cancel (struct workqueue *, struct work *);
+void workqueue_flush (struct workqueue *);
+
+#endif /* threads/workqueue.h */
@@ -123,8 +123,10 @@ start_process (void *f_name)
 
   palloc_free_page (file_name);
 
-  /* Project2 : if success, add child list to their parent thread */ 
+  /* Project2 : if success, add child list to their parent thread,
+     which will detach us once it no longer needs our exit status */ 
   if (success) {
+      thread_current()->detached = false;
       list_push_back(&thread_current()->parent_t->child_list, &thread_current()->c_elem);
   }
   /*Project2 : Finish success, so up their parent's sema */
@@ -166,14 +168,14 @@ process_wait (tid_t child_tid UNUSED)
   c_p->wait = true;
   
   /* Project2 : Wait for child thread exit */
-  sema_down(&c_p->c_sema);
+  completion_wait (&c_p->exited);
 
   /* Project2 : Get child's exit status and remove them from child list */
   status = c_p->exit_status;
   list_remove(&c_p->c_elem);
   
-  /* Project2 : up child sema to they can delete their structure */
-  sema_up(&c_p->p_sema);
+  /* Project2 : child structure can now be freed */
+  thread_detach(c_p);
 
   return status;
 }
@@ -193,9 +195,9 @@ process_exit (void)
   remove_child_process_all();
   remove_all_file();
   
-  /* Project2 : Wait for parent get our structure */
-  sema_up(&curr->c_sema);
-  sema_down(&curr->p_sema);
+  /* Project2 : Wake up waiting parent.  Our structure stays around
+     as a zombie until the parent detaches it. */
+  complete (&curr->exited);
  
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
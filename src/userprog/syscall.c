@@ -1,12 +1,13 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "threads/init.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
 #include "userprog/process.h"
 #include "userprog/pagedir.h"
 #include "devices/input.h"
@@ -15,6 +16,9 @@
 
 static void syscall_handler (struct intr_frame *);
 
+/* Cache of `struct file_info's. */
+static struct kmem_cache *file_info_cache;
+
 /* Project2 : Syscall function */
 void halt (void);
 void exit (int status);
@@ -37,9 +41,11 @@ bool readdir (int fd, char *name);
 bool isdir (int fd);
 int inumber (int fd);
 */
+int latency_histogram (unsigned *counts, int cnt);
 
 /* Project2 : additiona function */
 void check_valid_user_pointer(const void *user_pointer);
+void check_writable_user_buffer(void *buffer, size_t size);
 struct file *fd_to_file (int fd);
 void get_args(struct intr_frame *f, int *args, int num);
 
@@ -47,6 +53,8 @@ void
 syscall_init (void) 
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
+  file_info_cache = kmem_cache_create ("file_info", sizeof (struct file_info),
+                                       0, NULL);
 }
 
 static void
@@ -155,6 +163,11 @@ syscall_handler (struct intr_frame *f UNUSED)
 //      get_args(f, args, 1);
 //      f->eax = inumber(args[0]);
 //      break;
+
+    case SYS_LATENCY:                /* Read wakeup latency histogram. */
+      get_args(f, args, 2);
+      f->eax = latency_histogram((unsigned *)args[0], args[1]);
+      break;
   }
 }
 
@@ -167,6 +180,20 @@ void check_valid_user_pointer(const void *user_pointer) {
   if(user_pointer == NULL || is_kernel_vaddr(user_pointer) || pagedir_get_page(pd, user_pointer) == NULL) exit(-1);
 }
 
+/* Exits the process unless every page of the SIZE-byte user
+   BUFFER is mapped writable. */
+void check_writable_user_buffer(void *buffer, size_t size) {
+    uint32_t *pd = thread_current()->pagedir;
+    uint8_t *start = buffer;
+    uint8_t *end = start + size;
+    uint8_t *page;
+
+    if (size == 0) return;
+    if (start == NULL || end < start || !is_user_vaddr(end - 1)) exit(-1);
+    for (page = pg_round_down(start); page < end; page += PGSIZE)
+        if (!pagedir_is_writable(pd, page)) exit(-1);
+}
+
 void halt(void) {
     power_off();
 }
@@ -199,7 +226,11 @@ int open (const char *file) {
     
     if (fp == NULL) return -1;
     
-    struct file_info *fi = malloc (sizeof(struct file_info));
+    struct file_info *fi = kmem_cache_alloc (file_info_cache);
+    if (fi == NULL) {
+        file_close(fp);
+        return -1;
+    }
     
     fi->fd = t->max_fd++;
     fi->file = fp;
@@ -293,7 +324,7 @@ void close (int fd) {
         if(fi->fd == fd) {
             file_close(fi->file);
             list_remove(f_elem);
-            free(fi);
+            kmem_cache_free(file_info_cache, fi);
             break;
         }
         f_elem = list_next(f_elem);
@@ -348,7 +379,7 @@ void remove_all_file(void) {
         f_elem = list_pop_front(&t->file_list);
         fi = list_entry(f_elem, struct file_info, elem);
         file_close(fi->file);
-        free(fi);
+        kmem_cache_free(file_info_cache, fi);
     }
 }
 
@@ -360,7 +391,7 @@ void remove_child_process_all(void) {
     while(!list_empty(&t->child_list)) {
         c_elem = list_pop_front(&t->child_list);
         c_p = list_entry(c_elem, struct thread, c_elem);
-        sema_up(&c_p->p_sema);
+        thread_detach(c_p);
     }
 }
 /*
@@ -385,3 +416,18 @@ bool isdir (int fd) {
 int inumber (int fd) {
 }
 */
+
+int latency_histogram (unsigned *counts, int cnt) {
+    unsigned snapshot[LATENCY_BUCKETS];
+    int total;
+
+    if (cnt < 0) return -1;
+    if (cnt > LATENCY_BUCKETS) cnt = LATENCY_BUCKETS;
+
+    /* Take the snapshot into kernel memory, then copy it out with
+       interrupts on, after making sure the copy cannot fault. */
+    total = thread_latency_histogram(snapshot, cnt);
+    check_writable_user_buffer(counts, cnt * sizeof *counts);
+    memcpy(counts, snapshot, cnt * sizeof *counts);
+    return total;
+}